@@ -0,0 +1,213 @@
+#pragma once
+#include "Exception.hpp"
+#include "Graph.hpp"
+#include "Memory.hpp"
+#include "TypeDef.hpp"
+#include "Vec.hpp"
+#include "internal/UtilMacro.hpp"
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <ranges>
+#include <type_traits>
+#include <variant>
+#if defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+namespace gsh {
+class CompressedGraph;
+namespace internal {
+// StreamVByte: one control byte holds the byte lengths (1-4) of the next four values
+struct StreamVByteTable {
+  u8 len[256];
+  u8 shuffle[256][16];
+  constexpr StreamVByteTable() : len{}, shuffle{} {
+    for(u32 c = 0; c != 256; ++c) {
+      u32 p = 0;
+      for(u32 k = 0; k != 4; ++k) {
+        const u32 l = ((c >> (2 * k)) & 3) + 1;
+        for(u32 b = 0; b != 4; ++b) shuffle[c][4 * k + b] = b < l ? p + b : 0xff;
+        p += l;
+      }
+      len[c] = p;
+    }
+  }
+};
+inline constexpr StreamVByteTable stream_vbyte_table;
+GSH_INTERNAL_INLINE constexpr const u8* StreamVByteDecode4(u8 ctrl, const u8* data, u32* out) {
+#if defined(__SSSE3__)
+  if(!std::is_constant_evaluated()) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(stream_vbyte_table.shuffle[ctrl]));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(v, s));
+    return data + stream_vbyte_table.len[ctrl];
+  }
+#endif
+  for(u32 k = 0; k != 4; ++k) {
+    const u32 l = ((ctrl >> (2 * k)) & 3) + 1;
+    u32 x = 0;
+    for(u32 b = 0; b != l; ++b) x |= static_cast<u32>(data[b]) << (8 * b);
+    out[k] = x;
+    data += l;
+  }
+  return data;
+}
+class CompressedAdjacencyList : public ViewInterface<CompressedAdjacencyList, Edge<>> {
+  friend class gsh::CompressedGraph;
+  const u8* ctrl;
+  const u8* data;
+  u32 deg, base;
+  constexpr CompressedAdjacencyList(const u8* c, u32 d, u32 b) : ctrl(c), data(c + (d + 3) / 4), deg(d), base(b) {}
+  class sentinel_impl {};
+  class iterator_impl {
+    friend class CompressedAdjacencyList;
+    const u8* ctrl = nullptr;
+    const u8* data = nullptr;
+    u32 rem = 0, idx = 0, cur = 0;
+    u32 buf[4]{};
+    constexpr void decode() {
+      data = StreamVByteDecode4(*(ctrl++), data, buf);
+      idx = 0;
+    }
+    constexpr iterator_impl(const u8* c, const u8* d, u32 n, u32 b) : ctrl(c), data(d), rem(n) {
+      if(rem == 0) return;
+      decode();
+      // the first value is the zigzag-encoded offset from the source vertex
+      cur = b + ((buf[0] >> 1) ^ (0u - (buf[0] & 1)));
+    }
+  public:
+    using difference_type = i32;
+    using value_type = Edge<>;
+    using reference = Edge<>;
+    using iterator_category = std::forward_iterator_tag;
+    constexpr iterator_impl() {}
+    constexpr Edge<> operator*() const noexcept { return Edge<>(cur); }
+    constexpr iterator_impl& operator++() {
+      if(--rem == 0) return *this;
+      if(++idx == 4) decode();
+      cur += buf[idx];
+      return *this;
+    }
+    constexpr iterator_impl operator++(int) {
+      auto copy = *this;
+      operator++();
+      return copy;
+    }
+    friend constexpr bool operator==(const iterator_impl& a, const iterator_impl& b) noexcept { return a.rem == b.rem && a.ctrl == b.ctrl; }
+    friend constexpr bool operator==(const iterator_impl& a, const sentinel_impl&) noexcept { return a.rem == 0; }
+  };
+public:
+  using iterator = iterator_impl;
+  using sentinel = sentinel_impl;
+  using const_iterator = iterator_impl;
+  using const_sentinel = sentinel_impl;
+  constexpr u32 size() const noexcept { return deg; }
+  constexpr bool empty() const noexcept { return deg == 0; }
+  constexpr iterator begin() const noexcept { return iterator(ctrl, data, deg, base); }
+  constexpr sentinel end() const noexcept { return {}; }
+};
+}
+// read-only directed graph; each neighbor list is sorted, gap-encoded and packed with StreamVByte
+class CompressedGraph : public internal::DirectedGraphInterface<CompressedGraph, std::monostate> {
+  // block of v: varint degree, control bytes, data bytes; it starts at base_[v >> base_shift] + rel_[v]
+  static constexpr u32 base_shift = 10;
+  u32 n_ = 0, m_ = 0;
+  Mem<u64> base_;
+  Mem<u32> rel_;
+  Mem<u8> bytes_;
+  constexpr void encode(u32 n, const Mem<u32>& off, Mem<u32>& to) {
+    n_ = n;
+    m_ = off[n];
+    base_ = Mem<u64>((n >> base_shift) + 1);
+    rel_ = Mem<u32>(n);
+    auto byte_len = [](u32 x) -> u32 { return x < (1u << 8) ? 1 : x < (1u << 16) ? 2 : x < (1u << 24) ? 3 : 4; };
+    auto varint_len = [](u32 x) -> u32 {
+      u32 l = 1;
+      while(x >= 0x80) x >>= 7, ++l;
+      return l;
+    };
+    auto value = [&](u32 v, u32 i) -> u32 {
+      if(i != off[v]) return to[i] - to[i - 1];
+      const u32 d = to[i] - v;
+      return (d << 1) ^ (0u - (d >> 31));
+    };
+    u64 total = 0;
+    for(u32 v = 0; v != n; ++v) {
+      std::sort(to.data() + off[v], to.data() + off[v + 1]);
+      if((v & ((1u << base_shift) - 1)) == 0) base_[v >> base_shift] = total;
+      rel_[v] = total - base_[v >> base_shift];
+      const u32 deg = off[v + 1] - off[v];
+      total += varint_len(deg) + (deg + 3) / 4;
+      for(u32 i = off[v]; i != off[v + 1]; ++i) total += byte_len(value(v, i));
+    }
+    // padding so that a 16-byte load never runs past the end
+    bytes_ = Mem<u8>(total + 16, 0);
+    for(u32 v = 0; v != n; ++v) {
+      u8* p = bytes_.data() + base_[v >> base_shift] + rel_[v];
+      u32 deg = off[v + 1] - off[v];
+      for(; deg >= 0x80; deg >>= 7) *(p++) = (deg & 0x7f) | 0x80;
+      *(p++) = deg;
+      u8* data = p + (off[v + 1] - off[v] + 3) / 4;
+      for(u32 i = off[v], k = 0; i != off[v + 1]; ++i, ++k) {
+        const u32 x = value(v, i), l = byte_len(x);
+        p[k / 4] |= (l - 1) << (2 * (k % 4));
+        for(u32 b = 0; b != l; ++b) *(data++) = (x >> (8 * b)) & 0xff;
+      }
+    }
+  }
+public:
+  constexpr CompressedGraph() = default;
+  // only the structure is stored, so weighted graphs are rejected instead of silently losing their weights
+  template<class G> requires requires(const G& g) { g.vertex_count(); } && (!requires { requires G::edge_type::is_weighted; }) constexpr explicit CompressedGraph(const G& g) {
+    const u32 n = g.vertex_count();
+    Mem<u32> off(n + 1);
+    off[0] = 0;
+    for(u32 v = 0; v != n; ++v) {
+      u32 d = 0;
+      for([[maybe_unused]] const auto& e : g[v]) ++d;
+      off[v + 1] = off[v] + d;
+    }
+    Mem<u32> to(off[n]);
+    for(u32 v = 0, i = 0; v != n; ++v) {
+      for(const auto& e : g[v]) to[i++] = e.to();
+    }
+    encode(n, off, to);
+  }
+  template<std::ranges::random_access_range R1, std::ranges::random_access_range R2> constexpr CompressedGraph(u32 n, const R1& from, const R2& to) {
+    const u32 m = std::ranges::size(from);
+#ifndef NDEBUG
+    if(std::ranges::size(to) != m) throw Exception("gsh::CompressedGraph::CompressedGraph / The sizes of from and to differ.");
+#endif
+    auto f = std::ranges::begin(from);
+    auto t = std::ranges::begin(to);
+    Mem<u32> off(n + 1, 0);
+    for(u32 i = 0; i != m; ++i) {
+#ifndef NDEBUG
+      if(static_cast<u32>(f[i]) >= n || static_cast<u32>(t[i]) >= n) throw Exception("gsh::CompressedGraph::CompressedGraph / The index is out of range. ( from=", f[i], ", to=", t[i], ", size=", n, " )");
+#endif
+      ++off[static_cast<u32>(f[i]) + 1];
+    }
+    for(u32 v = 0; v != n; ++v) off[v + 1] += off[v];
+    Mem<u32> pos = off, adj(m);
+    for(u32 i = 0; i != m; ++i) adj[pos[f[i]]++] = t[i];
+    encode(n, off, adj);
+  }
+  constexpr u32 vertex_count() const noexcept { return n_; }
+  constexpr u32 edge_count() const noexcept { return m_; }
+  // bytes used by the adjacency encoding, including the per-vertex index
+  constexpr u64 byte_size() const noexcept { return bytes_.size() + rel_.size() * sizeof(u32) + base_.size() * sizeof(u64); }
+  constexpr internal::CompressedAdjacencyList operator[](u32 v) const {
+#ifndef NDEBUG
+    if(v >= vertex_count()) [[unlikely]]
+      throw Exception("gsh::CompressedGraph::operator[] / The index is out of range. ( v=", v, ", size=", vertex_count(), " )");
+#endif
+    const u8* p = bytes_.data() + base_[v >> base_shift] + rel_[v];
+    u32 deg = 0;
+    for(u32 sh = 0;; sh += 7) {
+      deg |= static_cast<u32>(*p & 0x7f) << sh;
+      if(!(*(p++) & 0x80)) break;
+    }
+    return internal::CompressedAdjacencyList(p, deg, v);
+  }
+};
+}
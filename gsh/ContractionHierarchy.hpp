@@ -0,0 +1,297 @@
+#pragma once
+#include "Exception.hpp"
+#include "Heap.hpp"
+#include "Memory.hpp"
+#include "TypeDef.hpp"
+#include "Vec.hpp"
+#include <limits>
+#include <ranges>
+#include <utility>
+namespace gsh {
+namespace internal {
+struct ContractionHeapLess {
+  constexpr bool operator()(const auto& a, const auto& b) const { return a.first < b.first; }
+};
+}
+template<class W> class ContractionHierarchy {
+public:
+  using size_type = u32;
+  using weight_type = W;
+  static constexpr size_type npos = 0xffffffffu;
+private:
+  struct Arc {
+    u32 v;
+    W w;
+    u32 id;
+  };
+  struct Piece {
+    u32 from, to;
+    u32 first, second;
+  };
+  struct UpArc {
+    u32 to;
+    u32 id;
+    W w;
+  };
+  using heap_type = Heap<std::pair<W, u32>, internal::ContractionHeapLess>;
+  static constexpr u32 witness_limit = 512;
+  static constexpr u32 simulate_limit = 32;
+  size_type n_ = 0;
+  Mem<u32> rank_;
+  Vec<Piece> pieces_;
+  Mem<u32> fwd_off_, bwd_off_;
+  Mem<UpArc> fwd_, bwd_;
+  Mem<W> fdist_, bdist_;
+  Mem<u32> fprev_, bprev_;
+  Vec<u32> touched_;
+  heap_type fq_, bq_;
+  u32 meet_ = npos;
+  static constexpr W inf() { return std::numeric_limits<W>::max(); }
+  template<class G> constexpr void build(const G& g) {
+    const u32 n = g.vertex_count();
+    n_ = n;
+    pieces_.clear();
+    Vec<Vec<Arc>> out(n), in(n);
+    for(u32 u = 0; u != n; ++u) {
+      for(const auto& e : g[u]) {
+        const u32 v = e.to();
+        const W w = static_cast<W>(e.weight());
+        if(u == v) continue;
+        bool found = false;
+        for(auto& a : out[u]) {
+          if(a.v != v) continue;
+          found = true;
+          if(w < a.w) {
+            a.w = w;
+            for(auto& b : in[v])
+              if(b.v == u) b.w = w;
+          }
+          break;
+        }
+        if(found) continue;
+        out[u].push_back(Arc{v, w, pieces_.size()});
+        in[v].push_back(Arc{u, w, pieces_.size()});
+        pieces_.push_back(Piece{u, v, npos, npos});
+      }
+    }
+    Mem<u8> contracted(n, 0);
+    Mem<u32> deleted_nb(n, 0);
+    Mem<W> wdist(n, inf());
+    Mem<u8> target(n, 0);
+    Vec<u32> wtouched;
+    heap_type wq;
+    auto witness = [&](u32 s, u32 skip, const W& limit, u32 targets, u32 max_settled) {
+      for(u32 x : wtouched) wdist[x] = inf();
+      wtouched.clear();
+      wq.clear();
+      wdist[s] = W{};
+      wtouched.push_back(s);
+      wq.emplace(W{}, s);
+      for(u32 settled = 0; !wq.empty() && settled != max_settled; ++settled) {
+        auto [d, x] = wq.min();
+        wq.pop_min();
+        if(d != wdist[x]) continue;
+        if(limit < d) break;
+        if(target[x] && --targets == 0) break;
+        for(const auto& a : out[x]) {
+          if(a.v == skip || contracted[a.v]) continue;
+          const W nd = d + a.w;
+          if(nd < wdist[a.v]) {
+            if(wdist[a.v] == inf()) wtouched.push_back(a.v);
+            wdist[a.v] = nd;
+            wq.emplace(nd, a.v);
+          }
+        }
+      }
+    };
+    auto contract = [&](u32 v, bool simulate) {
+      u32 added = 0;
+      W max_out{};
+      for(const auto& b : out[v]) {
+        if(max_out < b.w) max_out = b.w;
+        target[b.v] = 1;
+      }
+      for(const auto& a : in[v]) {
+        if(contracted[a.v]) continue;
+        witness(a.v, v, a.w + max_out, out[v].size(), simulate ? simulate_limit : witness_limit);
+        for(const auto& b : out[v]) {
+          if(contracted[b.v] || b.v == a.v) continue;
+          const W cand = a.w + b.w;
+          if(wdist[b.v] <= cand) continue;
+          ++added;
+          if(simulate) continue;
+          const u32 id = pieces_.size();
+          pieces_.push_back(Piece{a.v, b.v, a.id, b.id});
+          bool found = false;
+          for(auto& c : out[a.v]) {
+            if(c.v != b.v) continue;
+            found = true;
+            if(cand < c.w) {
+              c.w = cand, c.id = id;
+              for(auto& d : in[b.v])
+                if(d.v == a.v) d.w = cand, d.id = id;
+            }
+            break;
+          }
+          if(!found) {
+            out[a.v].push_back(Arc{b.v, cand, id});
+            in[b.v].push_back(Arc{a.v, cand, id});
+          }
+        }
+      }
+      for(const auto& b : out[v]) target[b.v] = 0;
+      return added;
+    };
+    Mem<u32> level(n, 0);
+    auto priority = [&](u32 v) { return 2 * (static_cast<i64>(contract(v, true)) - static_cast<i64>(in[v].size() + out[v].size())) + deleted_nb[v] + level[v]; };
+    Heap<std::pair<i64, u32>, internal::ContractionHeapLess> order;
+    Mem<i64> prio(n);
+    order.reserve(n);
+    for(u32 v = 0; v != n; ++v) order.emplace(prio[v] = priority(v), v);
+    rank_ = Mem<u32>(n);
+    auto remove = [](Vec<Arc>& arcs, u32 v) {
+      for(u32 i = 0; i != arcs.size(); ++i) {
+        if(arcs[i].v != v) continue;
+        arcs[i] = arcs.back();
+        arcs.pop_back();
+        return;
+      }
+    };
+    Vec<Arc> up_out, down_in;
+    Vec<u32> up_owner, down_owner;
+    for(u32 r = 0; r != n; ++r) {
+      u32 v;
+      while(true) {
+        auto [p, x] = order.min();
+        order.pop_min();
+        if(contracted[x] || p != prio[x]) continue;
+        const i64 q = priority(x);
+        if(order.empty() || q <= order.min().first) {
+          v = x;
+          break;
+        }
+        order.emplace(prio[x] = q, x);
+      }
+      contract(v, false);
+      contracted[v] = 1;
+      rank_[v] = r;
+      for(const auto& b : out[v]) {
+        up_out.push_back(b);
+        up_owner.push_back(v);
+        ++deleted_nb[b.v];
+        if(level[b.v] < level[v] + 1) level[b.v] = level[v] + 1;
+        remove(in[b.v], v);
+      }
+      for(const auto& a : in[v]) {
+        down_in.push_back(a);
+        down_owner.push_back(v);
+        ++deleted_nb[a.v];
+        if(level[a.v] < level[v] + 1) level[a.v] = level[v] + 1;
+        remove(out[a.v], v);
+      }
+      out[v].reset();
+      in[v].reset();
+    }
+    auto to_csr = [&](const Vec<Arc>& arcs, const Vec<u32>& owner, Mem<u32>& off, Mem<UpArc>& csr) {
+      off = Mem<u32>(n + 1, 0);
+      for(u32 x : owner) ++off[x + 1];
+      for(u32 i = 0; i != n; ++i) off[i + 1] += off[i];
+      csr = Mem<UpArc>(arcs.size());
+      Mem<u32> pos = off;
+      for(u32 i = 0; i != arcs.size(); ++i) csr[pos[owner[i]]++] = UpArc{arcs[i].v, arcs[i].id, arcs[i].w};
+    };
+    to_csr(up_out, up_owner, fwd_off_, fwd_);
+    to_csr(down_in, down_owner, bwd_off_, bwd_);
+    fdist_ = Mem<W>(n, inf());
+    bdist_ = Mem<W>(n, inf());
+    fprev_ = Mem<u32>(n, npos);
+    bprev_ = Mem<u32>(n, npos);
+    touched_.clear();
+  }
+  constexpr W query(u32 s, u32 t) {
+#ifndef NDEBUG
+    if(s >= n_ || t >= n_) throw Exception("gsh::ContractionHierarchy::query / The index is out of range. ( s=", s, ", t=", t, ", n=", n_, " )");
+#endif
+    for(u32 x : touched_) fdist_[x] = bdist_[x] = inf(), fprev_[x] = bprev_[x] = npos;
+    touched_.clear();
+    fq_.clear();
+    bq_.clear();
+    W best = inf();
+    meet_ = npos;
+    fdist_[s] = W{};
+    bdist_[t] = W{};
+    touched_.push_back(s);
+    touched_.push_back(t);
+    if(s == t) {
+      meet_ = s;
+      return W{};
+    }
+    fq_.emplace(W{}, s);
+    bq_.emplace(W{}, t);
+    auto step = [&](heap_type& q, Mem<W>& dist, Mem<u32>& prev, const Mem<W>& other, const Mem<u32>& off, const Mem<UpArc>& arcs, const Mem<u32>& stall_off, const Mem<UpArc>& stall_arcs) {
+      auto [d, x] = q.min();
+      q.pop_min();
+      if(d != dist[x]) return;
+      if(other[x] != inf() && d + other[x] < best) best = d + other[x], meet_ = x;
+      for(u32 i = stall_off[x]; i != stall_off[x + 1]; ++i) {
+        const auto& a = stall_arcs[i];
+        if(dist[a.to] != inf() && dist[a.to] + a.w < d) return;
+      }
+      for(u32 i = off[x]; i != off[x + 1]; ++i) {
+        const auto& a = arcs[i];
+        const W nd = d + a.w;
+        if(nd < dist[a.to]) {
+          if(fdist_[a.to] == inf() && bdist_[a.to] == inf()) touched_.push_back(a.to);
+          dist[a.to] = nd;
+          prev[a.to] = a.id;
+          q.emplace(nd, a.to);
+        }
+      }
+    };
+    bool forward = true;
+    while(true) {
+      const bool fa = !fq_.empty() && fq_.min().first < best;
+      const bool ba = !bq_.empty() && bq_.min().first < best;
+      if(!fa && !ba) break;
+      if(fa && (forward || !ba)) step(fq_, fdist_, fprev_, bdist_, fwd_off_, fwd_, bwd_off_, bwd_);
+      else step(bq_, bdist_, bprev_, fdist_, bwd_off_, bwd_, fwd_off_, fwd_);
+      forward = !forward;
+    }
+    return best;
+  }
+  constexpr void unpack(u32 id, Vec<u32>& res) const {
+    Vec<u32> st;
+    st.push_back(id);
+    while(!st.empty()) {
+      const u32 x = st.back();
+      st.pop_back();
+      const Piece& p = pieces_[x];
+      if(p.first == npos) res.push_back(p.to);
+      else st.push_back(p.second), st.push_back(p.first);
+    }
+  }
+public:
+  constexpr ContractionHierarchy() = default;
+  template<class G> constexpr explicit ContractionHierarchy(const G& g) { build(g); }
+  template<class G> constexpr void assign(const G& g) { build(g); }
+  constexpr size_type vertex_count() const noexcept { return n_; }
+  constexpr size_type rank(u32 v) const { return rank_[v]; }
+  constexpr size_type shortcut_count() const noexcept {
+    u32 cnt = 0;
+    for(const auto& p : pieces_) cnt += p.first != npos;
+    return cnt;
+  }
+  constexpr W dist(u32 s, u32 t) { return query(s, t); }
+  constexpr bool is_reachable(u32 s, u32 t) { return query(s, t) != inf(); }
+  // the same vertex sequence as ShortestPathResult::path, empty if t is unreachable
+  constexpr Vec<u32> path(u32 s, u32 t) {
+    if(query(s, t) == inf()) return {};
+    Vec<u32> up, res;
+    for(u32 x = meet_; x != s; x = pieces_[fprev_[x]].from) up.push_back(fprev_[x]);
+    res.push_back(s);
+    for(u32 i = up.size(); i--;) unpack(up[i], res);
+    for(u32 x = meet_; x != t; x = pieces_[bprev_[x]].to) unpack(bprev_[x], res);
+    return res;
+  }
+};
+}
@@ -0,0 +1,251 @@
+#pragma once
+#include "Exception.hpp"
+#include "Graph.hpp"
+#include "Range.hpp"
+#include "TypeDef.hpp"
+#include "UnionFind.hpp"
+#include "Vec.hpp"
+#include <algorithm>
+#include <bit>
+#include <tuple>
+#include <utility>
+#include <variant>
+namespace gsh {
+namespace internal {
+// adjacency lists with swap-remove; every arc remembers its slot so erasing is O(1)
+template<class W> class DynamicAdjacency {
+protected:
+  constexpr static u32 npos = 0xffffffffu;
+  Vec<Vec<Edge<W>>> adj;
+  Vec<Vec<u32>> slot_arc;
+  Vec<std::pair<u32, u32>> where;
+  constexpr void place(u32 arc, u32 from, const Edge<W>& e) {
+    if(where.size() <= arc) where.resize(arc + 1, {npos, npos});
+    where[arc] = {from, adj[from].size()};
+    adj[from].push_back(e);
+    slot_arc[from].push_back(arc);
+  }
+  constexpr void remove(u32 arc) {
+    const auto [v, i] = where[arc];
+    const u32 last = adj[v].size() - 1;
+    if(i != last) {
+      adj[v][i] = adj[v][last];
+      slot_arc[v][i] = slot_arc[v][last];
+      where[slot_arc[v][i]].second = i;
+    }
+    adj[v].pop_back();
+    slot_arc[v].pop_back();
+    where[arc] = {npos, npos};
+  }
+  constexpr bool placed(u32 arc) const noexcept { return arc < where.size() && where[arc].first != npos; }
+public:
+  constexpr DynamicAdjacency() {}
+  constexpr explicit DynamicAdjacency(u32 n) : adj(n), slot_arc(n) {}
+  constexpr u32 vertex_count() const noexcept { return adj.size(); }
+  constexpr u32 add_vertex() {
+    adj.emplace_back();
+    slot_arc.emplace_back();
+    return adj.size() - 1;
+  }
+  constexpr auto operator[](u32 v) const {
+#ifndef NDEBUG
+    if(v >= vertex_count()) [[unlikely]]
+      throw Exception("gsh::internal::DynamicAdjacency::operator[] / The index is out of range. ( v=", v, ", size=", vertex_count(), " )");
+#endif
+    return Subrange(adj[v].data(), adj[v].data() + adj[v].size());
+  }
+};
+}
+// edge ids are reused after erase_edge; adjacency order changes when an edge is erased
+template<class W = std::monostate> class DynamicDirectedGraph : public internal::DynamicAdjacency<W>, public internal::DirectedGraphInterface<DynamicDirectedGraph<W>, W> {
+  using base = internal::DynamicAdjacency<W>;
+  Vec<u32> free_ids;
+  u32 m = 0;
+  constexpr u32 new_id() {
+    if(free_ids.empty()) return base::where.size();
+    const u32 id = free_ids.back();
+    free_ids.pop_back();
+    return id;
+  }
+public:
+  constexpr DynamicDirectedGraph() = default;
+  constexpr explicit DynamicDirectedGraph(u32 n) : base(n) {}
+  constexpr u32 edge_count() const noexcept { return m; }
+  constexpr bool contains_edge(u32 id) const noexcept { return base::placed(id); }
+  constexpr u32 add_edge(u32 from, u32 to) requires (!Edge<W>::is_weighted) {
+#ifndef NDEBUG
+    if(from >= base::vertex_count() || to >= base::vertex_count()) throw Exception("gsh::DynamicDirectedGraph::add_edge / The index is out of range. ( from=", from, ", to=", to, ", size=", base::vertex_count(), " )");
+#endif
+    const u32 id = new_id();
+    base::place(id, from, Edge<W>(to));
+    ++m;
+    return id;
+  }
+  constexpr u32 add_edge(u32 from, u32 to, const W& w) requires Edge<W>::is_weighted {
+#ifndef NDEBUG
+    if(from >= base::vertex_count() || to >= base::vertex_count()) throw Exception("gsh::DynamicDirectedGraph::add_edge / The index is out of range. ( from=", from, ", to=", to, ", size=", base::vertex_count(), " )");
+#endif
+    const u32 id = new_id();
+    base::place(id, from, Edge<W>(to, w));
+    ++m;
+    return id;
+  }
+  constexpr void erase_edge(u32 id) {
+#ifndef NDEBUG
+    if(!base::placed(id)) throw Exception("gsh::DynamicDirectedGraph::erase_edge / The edge does not exist. ( id=", id, " )");
+#endif
+    base::remove(id);
+    free_ids.push_back(id);
+    --m;
+  }
+};
+// edge id k owns the arcs 2k and 2k + 1
+template<class W = std::monostate> class DynamicUndirectedGraph : public internal::DynamicAdjacency<W>, public internal::UndirectedGraphInterface<DynamicUndirectedGraph<W>, W> {
+  using base = internal::DynamicAdjacency<W>;
+  Vec<u32> free_ids;
+  u32 m = 0;
+  constexpr u32 new_id() {
+    if(free_ids.empty()) return base::where.size() / 2;
+    const u32 id = free_ids.back();
+    free_ids.pop_back();
+    return id;
+  }
+public:
+  constexpr DynamicUndirectedGraph() = default;
+  constexpr explicit DynamicUndirectedGraph(u32 n) : base(n) {}
+  constexpr u32 edge_count() const noexcept { return m; }
+  constexpr bool contains_edge(u32 id) const noexcept { return base::placed(2 * id); }
+  constexpr u32 add_edge(u32 a, u32 b) requires (!Edge<W>::is_weighted) {
+#ifndef NDEBUG
+    if(a >= base::vertex_count() || b >= base::vertex_count()) throw Exception("gsh::DynamicUndirectedGraph::add_edge / The index is out of range. ( a=", a, ", b=", b, ", size=", base::vertex_count(), " )");
+#endif
+    const u32 id = new_id();
+    base::place(2 * id, a, Edge<W>(b));
+    base::place(2 * id + 1, b, Edge<W>(a));
+    ++m;
+    return id;
+  }
+  constexpr u32 add_edge(u32 a, u32 b, const W& w) requires Edge<W>::is_weighted {
+#ifndef NDEBUG
+    if(a >= base::vertex_count() || b >= base::vertex_count()) throw Exception("gsh::DynamicUndirectedGraph::add_edge / The index is out of range. ( a=", a, ", b=", b, ", size=", base::vertex_count(), " )");
+#endif
+    const u32 id = new_id();
+    base::place(2 * id, a, Edge<W>(b, w));
+    base::place(2 * id + 1, b, Edge<W>(a, w));
+    ++m;
+    return id;
+  }
+  constexpr void erase_edge(u32 id) {
+#ifndef NDEBUG
+    if(!base::placed(2 * id)) throw Exception("gsh::DynamicUndirectedGraph::erase_edge / The edge does not exist. ( id=", id, " )");
+#endif
+    base::remove(2 * id);
+    base::remove(2 * id + 1);
+    free_ids.push_back(id);
+    --m;
+  }
+};
+// connectivity under edge insertions and deletions, answered offline with a segment tree over time and RollbackUnionFind
+class OfflineDynamicConnectivity {
+  constexpr static u32 npos = 0xffffffffu;
+  struct Event {
+    u32 a, b, t;
+    bool add;
+  };
+  u32 n_ = 0;
+  Vec<Event> events_;
+  Vec<std::pair<u32, u32>> queries_;
+public:
+  constexpr OfflineDynamicConnectivity() = default;
+  constexpr explicit OfflineDynamicConnectivity(u32 n) : n_(n) {}
+  constexpr u32 vertex_count() const noexcept { return n_; }
+  constexpr void add_edge(u32 a, u32 b) {
+#ifndef NDEBUG
+    if(a >= n_ || b >= n_) throw Exception("gsh::OfflineDynamicConnectivity::add_edge / The index is out of range. ( a=", a, ", b=", b, ", n=", n_, " )");
+#endif
+    if(a > b) std::swap(a, b);
+    events_.push_back(Event{a, b, queries_.size(), true});
+  }
+  // erases one of the current copies of the edge (a, b)
+  constexpr void erase_edge(u32 a, u32 b) {
+#ifndef NDEBUG
+    if(a >= n_ || b >= n_) throw Exception("gsh::OfflineDynamicConnectivity::erase_edge / The index is out of range. ( a=", a, ", b=", b, ", n=", n_, " )");
+#endif
+    if(a > b) std::swap(a, b);
+    events_.push_back(Event{a, b, queries_.size(), false});
+  }
+  // the answer is 1 if a and b are connected at this point, 0 otherwise
+  constexpr u32 query_same(u32 a, u32 b) {
+#ifndef NDEBUG
+    if(a >= n_ || b >= n_) throw Exception("gsh::OfflineDynamicConnectivity::query_same / The index is out of range. ( a=", a, ", b=", b, ", n=", n_, " )");
+#endif
+    queries_.emplace_back(a, b);
+    return queries_.size() - 1;
+  }
+  // the answer is the number of connected components at this point
+  constexpr u32 query_count() {
+    queries_.emplace_back(npos, npos);
+    return queries_.size() - 1;
+  }
+  // answers in the order the queries were issued
+  constexpr Vec<u32> solve() const {
+    const u32 q = queries_.size();
+    Vec<u32> res(q);
+    if(q == 0) return res;
+    Vec<u32> order(events_.size());
+    for(u32 i = 0; i != order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](u32 x, u32 y) { return events_[x].a != events_[y].a ? events_[x].a < events_[y].a : events_[x].b < events_[y].b; });
+    const u32 sz = std::bit_ceil(q);
+    // each edge copy lives during [l, r) of the query timeline
+    Vec<std::tuple<u32, u32, u32, u32>> live;
+    Vec<u32> open;
+    for(u32 i = 0, j = 0; i != order.size(); i = j) {
+      open.clear();
+      const Event& key = events_[order[i]];
+      for(; j != order.size() && events_[order[j]].a == key.a && events_[order[j]].b == key.b; ++j) {
+        const Event& e = events_[order[j]];
+        if(e.add) {
+          open.push_back(e.t);
+          continue;
+        }
+#ifndef NDEBUG
+        if(open.empty()) throw Exception("gsh::OfflineDynamicConnectivity::solve / An edge is erased before it is added. ( a=", e.a, ", b=", e.b, " )");
+#endif
+        if(open.back() != e.t) live.emplace_back(key.a, key.b, open.back(), e.t);
+        open.pop_back();
+      }
+      for(const u32 l : open)
+        if(l != q) live.emplace_back(key.a, key.b, l, q);
+    }
+    Vec<u32> off(2 * sz + 1, 0);
+    auto each_node = [&](u32 l, u32 r, auto&& f) {
+      for(l += sz, r += sz; l < r; l >>= 1, r >>= 1) {
+        if(l & 1) f(l++);
+        if(r & 1) f(--r);
+      }
+    };
+    for(const auto& [a, b, l, r] : live) each_node(l, r, [&](u32 k) { ++off[k + 1]; });
+    for(u32 k = 0; k != 2 * sz; ++k) off[k + 1] += off[k];
+    Vec<std::pair<u32, u32>> node_edges(off[2 * sz]);
+    Vec<u32> pos(off.begin(), off.end() - 1);
+    for(const auto& [a, b, l, r] : live) each_node(l, r, [&](u32 k) { node_edges[pos[k]++] = {a, b}; });
+    RollbackUnionFind uf(n_);
+    auto dfs = [&](auto&& self, u32 k) -> void {
+      const auto st = uf.current();
+      for(u32 i = off[k]; i != off[k + 1]; ++i) uf.merge(node_edges[i].first, node_edges[i].second);
+      if(k >= sz) {
+        if(k - sz < q) {
+          const auto [a, b] = queries_[k - sz];
+          res[k - sz] = a == npos ? uf.count_groups() : static_cast<u32>(uf.same(a, b));
+        }
+      } else if(((k << (std::countl_zero(k) - std::countl_zero(sz))) - sz) < q) {
+        self(self, 2 * k);
+        self(self, 2 * k + 1);
+      }
+      uf.rollback(st);
+    };
+    dfs(dfs, 1);
+    return res;
+  }
+};
+}
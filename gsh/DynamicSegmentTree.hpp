@@ -0,0 +1,296 @@
+#pragma once
+#include "Exception.hpp"
+#include "LazySegmentTree.hpp"
+#include "SegmentTree.hpp"
+#include "TypeDef.hpp"
+#include "Vec.hpp"
+#include <algorithm>
+#include <bit>
+#include <concepts>
+#include <iterator>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+namespace gsh {
+namespace internal {
+// lets one container take either a MakeSegmentSpec or a MakeLazySegmentSpec spec
+template<class Spec> struct SegmentSpecTraits {
+  constexpr static bool is_lazy = false;
+  using internal_value_type = typename Spec::value_type;
+  using operator_type = std::tuple<>;
+  using internal_operator_type = std::tuple<>;
+};
+template<class Spec> requires IsLazySegmentSpecImplemented<Spec> struct SegmentSpecTraits<Spec> {
+  constexpr static bool is_lazy = true;
+  using internal_value_type = typename Spec::internal_value_type;
+  using operator_type = typename Spec::operator_type;
+  using internal_operator_type = typename Spec::internal_operator_type;
+};
+template<class Spec> concept IsAnySegmentSpec = IsSegmentSpecImplemented<Spec> || IsLazySegmentSpecImplemented<Spec>;
+// beats specs are excluded: a failed mapping would have to descend into children that were never created
+template<class Spec> concept IsDynamicSegmentSpec = IsAnySegmentSpec<Spec> && (!IsLazySegmentSpecImplemented<Spec> || requires(Spec s, typename Spec::internal_operator_type f, typename Spec::internal_value_type x) {
+  { s.mapping(f, x) } -> std::same_as<typename Spec::internal_value_type>;
+});
+}
+// Segment tree over the index space [0, n) with n up to 2^64 - 1. Nodes are created on demand, so memory is O(q log n) for q updates.
+// Positions that were never written hold the initial value (spec.e() unless one is given).
+template<class Spec> requires internal::IsDynamicSegmentSpec<Spec> class DynamicSegmentTree {
+  [[no_unique_address]] Spec spec;
+  using traits = internal::SegmentSpecTraits<Spec>;
+  constexpr static bool is_lazy = traits::is_lazy;
+public:
+  using value_type = typename Spec::value_type;
+  using operator_type = typename traits::operator_type;
+  using internal_value_type = typename traits::internal_value_type;
+  using internal_operator_type = typename traits::internal_operator_type;
+  using size_type = u64;
+private:
+  struct Node {
+    internal_value_type val;
+    [[no_unique_address]] internal_operator_type lz;
+    u32 child[2];
+  };
+  u64 n = 0;
+  u32 height = 0;
+  internal_value_type fill[64];  // fill[d] is the product of 2^d initial values, for d <= height
+  Vec<Node> arena;  // arena[1] is the root; child index 0 means "not created yet"
+  GSH_INTERNAL_INLINE constexpr static u64 span(u32 d) { return d == 64 ? ~0ull : (1ull << d) - 1; }
+  GSH_INTERNAL_INLINE constexpr internal_value_type e() const { return spec.e(); }
+  GSH_INTERNAL_INLINE constexpr internal_operator_type id() const {
+    if constexpr(is_lazy) return spec.id();
+    else return {};
+  }
+  GSH_INTERNAL_INLINE constexpr internal_value_type embed(const value_type& x) const {
+    if constexpr(is_lazy) return spec.embed_value(x);
+    else return x;
+  }
+  GSH_INTERNAL_INLINE constexpr value_type extract(const internal_value_type& x) const {
+    if constexpr(is_lazy) return spec.extract(x);
+    else return x;
+  }
+  // product of len initial values
+  constexpr internal_value_type repeat(u64 len) const {
+    internal_value_type res = e();
+    for(; len != 0; len &= len - 1) res = spec.op(res, fill[std::countr_zero(len)]);
+    return res;
+  }
+  // initial value of the node [a, a + span(d)], clipped to [0, n)
+  constexpr internal_value_type initial(u64 a, u32 d) const {
+    if(a >= n) return e();
+    return repeat(std::min(a + span(d), n - 1) - a + 1);
+  }
+  constexpr void init(u64 m, const internal_value_type& x) {
+    n = m;
+    height = n <= 1 ? 0 : std::bit_width(n - 1);
+    fill[0] = x;
+    for(u32 d = 1; d <= height && d != 64; ++d) fill[d] = spec.op(fill[d - 1], fill[d - 1]);
+    clear();
+  }
+  constexpr u32 make(u64 a, u32 d) {
+    arena.emplace_back(Node{initial(a, d), id(), {0, 0}});
+    return arena.size() - 1;
+  }
+  constexpr internal_value_type value_of(u32 k, u64 a, u32 d) const { return k != 0 ? arena[k].val : initial(a, d); }
+  constexpr void pull(u32 k, u64 a, u32 d) {
+    const u64 mid = a + (1ull << (d - 1));
+    arena[k].val = spec.op(value_of(arena[k].child[0], a, d - 1), value_of(arena[k].child[1], mid, d - 1));
+  }
+  constexpr void all_apply(u32 k, const internal_operator_type& f) requires is_lazy {
+    arena[k].val = spec.mapping(f, arena[k].val);
+    arena[k].lz = spec.composition(f, arena[k].lz);
+  }
+  constexpr void push(u32 k, u64 a, u32 d) requires is_lazy {
+    const u64 mid = a + (1ull << (d - 1));
+    for(u32 s = 0; s != 2; ++s) {
+      if(arena[k].child[s] == 0) {
+        const u32 c = make(s ? mid : a, d - 1);
+        arena[k].child[s] = c;
+      }
+    }
+    const internal_operator_type f = arena[k].lz;
+    all_apply(arena[k].child[0], f);
+    all_apply(arena[k].child[1], f);
+    arena[k].lz = spec.id();
+  }
+  constexpr void set(u32 k, u64 a, u32 d, u64 i, const internal_value_type& x) {
+    if(d == 0) {
+      arena[k].val = x;
+      return;
+    }
+    if constexpr(is_lazy) push(k, a, d);
+    const u64 mid = a + (1ull << (d - 1));
+    const u32 s = i >= mid;
+    u32 c = arena[k].child[s];
+    if(c == 0) {
+      c = make(s ? mid : a, d - 1);
+      arena[k].child[s] = c;
+    }
+    set(c, s ? mid : a, d - 1, i, x);
+    pull(k, a, d);
+  }
+  // [l, r] is inclusive so that r can be 2^64 - 2 without overflow; acc is the composition of the pending operators above k
+  constexpr internal_value_type prod(u32 k, u64 a, u32 d, u64 l, u64 r, const internal_operator_type& acc) const {
+    const u64 b = a + span(d);
+    if(r < a || b < l) return e();
+    if(k == 0) {
+      const internal_value_type x = l <= a && b <= r ? initial(a, d) : repeat(std::min(b, r) - std::max(a, l) + 1);
+      if constexpr(is_lazy) return spec.mapping(acc, x);
+      else return x;
+    }
+    if(l <= a && b <= r) {
+      if constexpr(is_lazy) return spec.mapping(acc, arena[k].val);
+      else return arena[k].val;
+    }
+    const u64 mid = a + (1ull << (d - 1));
+    if constexpr(is_lazy) {
+      const internal_operator_type next = spec.composition(acc, arena[k].lz);
+      return spec.op(prod(arena[k].child[0], a, d - 1, l, r, next), prod(arena[k].child[1], mid, d - 1, l, r, next));
+    } else {
+      return spec.op(prod(arena[k].child[0], a, d - 1, l, r, acc), prod(arena[k].child[1], mid, d - 1, l, r, acc));
+    }
+  }
+  constexpr void apply(u32 k, u64 a, u32 d, u64 l, u64 r, const internal_operator_type& f) requires is_lazy {
+    const u64 b = a + span(d);
+    if(r < a || b < l) return;
+    if(l <= a && b <= r) {
+      all_apply(k, f);
+      return;
+    }
+    push(k, a, d);
+    const u64 mid = a + (1ull << (d - 1));
+    apply(arena[k].child[0], a, d - 1, l, r, f);
+    apply(arena[k].child[1], mid, d - 1, l, r, f);
+    pull(k, a, d);
+  }
+public:
+  constexpr DynamicSegmentTree() : DynamicSegmentTree(0) {}
+  constexpr DynamicSegmentTree(Spec spec) : DynamicSegmentTree(0, spec) {}
+  constexpr DynamicSegmentTree(u64 n, Spec spec = Spec()) : spec(spec) { init(n, this->spec.e()); }
+  constexpr DynamicSegmentTree(u64 n, const value_type& value, Spec spec = Spec()) : spec(spec) { init(n, embed(value)); }
+  constexpr void assign(u64 n, const value_type& value) { init(n, embed(value)); }
+  // drops every update; all positions return to the initial value
+  constexpr void clear() {
+    arena.clear();
+    arena.emplace_back(Node{e(), id(), {0, 0}});
+    make(0, height);
+  }
+  constexpr void swap(DynamicSegmentTree& r) {
+    using std::swap;
+    swap(spec, r.spec);
+    swap(n, r.n);
+    swap(height, r.height);
+    swap(fill, r.fill);
+    swap(arena, r.arena);
+  }
+  constexpr u64 size() const { return n; }
+  constexpr bool empty() const { return n == 0; }
+  constexpr u32 node_count() const { return arena.size() - 1; }
+  constexpr void reserve(u32 nodes) { arena.reserve(nodes); }
+  constexpr void set(u64 i, const value_type& x) {
+#ifndef NDEBUG
+    if(i >= n) throw Exception("DynamicSegmentTree::set: index ", i, " is out of range [0, ", n, ")");
+#endif
+    set(1, 0, height, i, embed(x));
+  }
+  constexpr value_type get(u64 i) const {
+#ifndef NDEBUG
+    if(i >= n) throw Exception("DynamicSegmentTree::get: index ", i, " is out of range [0, ", n, ")");
+#endif
+    return extract(prod(1, 0, height, i, i, id()));
+  }
+  constexpr value_type operator[](u64 i) const { return get(i); }
+  constexpr value_type prod(u64 l, u64 r) const {
+#ifndef NDEBUG
+    if(l > r || r > n) throw Exception("DynamicSegmentTree::prod: invalid range [", l, ", ", r, ") with size ", n);
+#endif
+    if(l == r) return extract(e());
+    return extract(prod(1, 0, height, l, r - 1, id()));
+  }
+  constexpr value_type all_prod() const { return extract(arena[1].val); }
+  constexpr void apply(u64 i, const operator_type& f) requires is_lazy {
+#ifndef NDEBUG
+    if(i >= n) throw Exception("DynamicSegmentTree::apply: index ", i, " is out of range [0, ", n, ")");
+#endif
+    apply(1, 0, height, i, i, spec.embed_operator(f));
+  }
+  constexpr void apply(u64 l, u64 r, const operator_type& f) requires is_lazy {
+#ifndef NDEBUG
+    if(l > r || r > n) throw Exception("DynamicSegmentTree::apply: invalid range [", l, ", ", r, ") with size ", n);
+#endif
+    if(l == r) return;
+    apply(1, 0, height, l, r - 1, spec.embed_operator(f));
+  }
+};
+namespace internal {
+template<class Spec, bool Lazy = SegmentSpecTraits<Spec>::is_lazy> struct CompressedSegmentTreeBase {
+  using type = SegmentTree<Spec>;
+};
+template<class Spec> struct CompressedSegmentTreeBase<Spec, true> {
+  using type = LazySegmentTree<Spec>;
+};
+}
+// Offline variant: every key that will ever be touched is given up front and mapped to a dense index of a SegmentTree / LazySegmentTree.
+template<class Spec> requires internal::IsAnySegmentSpec<Spec> class CompressedSegmentTree {
+  using traits = internal::SegmentSpecTraits<Spec>;
+  constexpr static bool is_lazy = traits::is_lazy;
+public:
+  using value_type = typename Spec::value_type;
+  using operator_type = typename traits::operator_type;
+  using key_type = u64;
+  using size_type = u32;
+  using tree_type = typename internal::CompressedSegmentTreeBase<Spec>::type;
+private:
+  Vec<key_type> keys;
+  tree_type tree;
+  template<class InputIt> constexpr void set_keys(InputIt first, InputIt last) {
+    keys.assign(first, last);
+    keys.sort();
+    keys.resize(std::unique(keys.begin(), keys.end()) - keys.begin());
+  }
+  constexpr size_type at(key_type key, [[maybe_unused]] const char* caller) const {
+    const size_type i = index(key);
+#ifndef NDEBUG
+    if(i == keys.size() || keys[i] != key) throw Exception("CompressedSegmentTree::", caller, ": key ", key, " was not registered");
+#endif
+    return i;
+  }
+public:
+  constexpr CompressedSegmentTree() {}
+  template<class InputIt> requires std::forward_iterator<InputIt> constexpr CompressedSegmentTree(InputIt first, InputIt last, Spec spec = Spec()) : tree(spec) {
+    set_keys(first, last);
+    tree = tree_type(keys.size(), spec);
+  }
+  template<class InputIt> requires std::forward_iterator<InputIt> constexpr CompressedSegmentTree(InputIt first, InputIt last, const value_type& value, Spec spec = Spec()) : tree(spec) {
+    set_keys(first, last);
+    tree = tree_type(keys.size(), value, spec);
+  }
+  constexpr size_type size() const { return keys.size(); }
+  constexpr bool empty() const { return keys.empty(); }
+  constexpr key_type key(size_type i) const { return keys[i]; }
+  // number of registered keys smaller than key
+  constexpr size_type index(key_type key) const { return std::lower_bound(keys.begin(), keys.end(), key) - keys.begin(); }
+  constexpr bool contains(key_type key) const {
+    const size_type i = index(key);
+    return i != keys.size() && keys[i] == key;
+  }
+  constexpr tree_type& base() { return tree; }
+  constexpr const tree_type& base() const { return tree; }
+  constexpr void set(key_type key, const value_type& x) { tree.set(at(key, "set"), x); }
+  constexpr value_type get(key_type key) { return tree.get(at(key, "get")); }
+  // product over the registered keys in [l, r)
+  constexpr value_type prod(key_type l, key_type r) {
+#ifndef NDEBUG
+    if(l > r) throw Exception("CompressedSegmentTree::prod: invalid range [", l, ", ", r, ")");
+#endif
+    return tree.prod(index(l), index(r));
+  }
+  constexpr value_type all_prod() const { return tree.all_prod(); }
+  constexpr void apply(key_type key, const operator_type& f) requires is_lazy { tree.apply(at(key, "apply"), f); }
+  constexpr void apply(key_type l, key_type r, const operator_type& f) requires is_lazy {
+#ifndef NDEBUG
+    if(l > r) throw Exception("CompressedSegmentTree::apply: invalid range [", l, ", ", r, ")");
+#endif
+    tree.apply(index(l), index(r), f);
+  }
+};
+}
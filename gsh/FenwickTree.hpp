@@ -2,9 +2,14 @@
 #include "Exception.hpp"
 #include "TypeDef.hpp"
 #include "Vec.hpp"
+#include <algorithm>
+#include <atomic>
 #include <bit>
+#include <concepts>
 #include <initializer_list>
 #include <iterator>
+#include <thread>
+#include <tuple>
 #include <type_traits>
 namespace gsh {
 template<class T> class FenwickTree {
@@ -126,4 +131,185 @@ public:
 };
 template<class U> constexpr void swap(FenwickTree<U>& x, FenwickTree<U>& y) noexcept(noexcept(x.swap(y))) { x.swap(y); }
 template<class InputIterator> FenwickTree(InputIterator, InputIterator) -> FenwickTree<typename std::iterator_traits<InputIterator>::value_type>;
+namespace internal {
+// builds the Fenwick nodes of [first, last) in a plain buffer, for containers whose nodes are atomics
+template<class T, class InputIterator> Vec<T> FenwickNodes(InputIterator first, InputIterator last) {
+  Vec<T> bit(first, last);
+  const u32 n = bit.size();
+  for(u32 i = 0; i + 1 < n; ++i) {
+    const u32 j = i + ((i + 1) & -(i + 1));
+    if(j < n) bit[j] += bit[i];
+  }
+  return bit;
+}
+}
+// FenwickTree that many threads may update at once. Every node update is a relaxed fetch_add, so writers never block each other.
+// With Snapshot = false reads are not linearizable: sum(n) counts each concurrent add either entirely or not at all, because a prefix path
+// and an update path share at most one node, but adds are not ordered, so two adds made by one thread may be observed as the second without
+// the first. sum(l, r) reads two prefix paths and may even see a single add on only one of them.
+// With Snapshot = true a read retries until no add overlapped it, at the cost of shared counters that every writer bumps. A reader that
+// keeps failing asks writers to pause before their next add, so it finishes once the adds in flight have completed.
+template<class T, bool Snapshot = false> class ConcurrentFenwickTree {
+  static_assert(std::is_arithmetic_v<T> && std::atomic<T>::is_always_lock_free, "gsh::ConcurrentFenwickTree / T must be a lock-free arithmetic type.");
+  Vec<std::atomic<T>> bit;
+  struct alignas(64) Counter {
+    std::atomic<u64> value{0};
+  };
+  [[no_unique_address]] std::conditional_t<Snapshot, Counter, std::tuple<>> started, finished;
+  [[no_unique_address]] mutable std::conditional_t<Snapshot, Counter, std::tuple<>> starving;  // readers that asked writers to pause
+  constexpr static u32 max_retries = 64;
+  template<class F> void write(F&& f) {
+    if constexpr(Snapshot) {
+      while(starving.value.load(std::memory_order_relaxed) != 0) std::this_thread::yield();
+      started.value.fetch_add(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      f();
+      finished.value.fetch_add(1, std::memory_order_release);
+    } else {
+      f();
+    }
+  }
+  T prefix(u32 n) const {
+    T res = {};
+    for(u32 i = n; i != 0; i &= i - 1) res += bit[i - 1].load(std::memory_order_relaxed);
+    return res;
+  }
+  template<class F> T read(F&& f) const {
+    if constexpr(Snapshot) {
+      for(u32 retry = 0;; ++retry) {
+        if(retry == max_retries) starving.value.fetch_add(1, std::memory_order_relaxed);
+        const u64 e = finished.value.load(std::memory_order_acquire);
+        const u64 b = started.value.load(std::memory_order_relaxed);
+        if(b != e) {
+          std::this_thread::yield();
+          continue;
+        }
+        const T res = f();
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(started.value.load(std::memory_order_relaxed) == b) {
+          if(retry >= max_retries) starving.value.fetch_sub(1, std::memory_order_relaxed);
+          return res;
+        }
+      }
+    } else {
+      return f();
+    }
+  }
+public:
+  using size_type = u32;
+  using difference_type = i32;
+  using value_type = T;
+  ConcurrentFenwickTree() = default;
+  explicit ConcurrentFenwickTree(u32 n) : bit(n) {}
+  template<class InputIterator> requires std::forward_iterator<InputIterator> ConcurrentFenwickTree(InputIterator first, InputIterator last) { assign(first, last); }
+  ConcurrentFenwickTree(std::initializer_list<T> il) : ConcurrentFenwickTree(il.begin(), il.end()) {}
+  u32 size() const noexcept { return bit.size(); }
+  bool empty() const noexcept { return bit.empty(); }
+  // not thread-safe
+  template<class InputIterator> void assign(InputIterator first, InputIterator last) {
+    const Vec<T> tmp = internal::FenwickNodes<T>(first, last);
+    bit = Vec<std::atomic<T>>(tmp.size());
+    for(u32 i = 0; i != tmp.size(); ++i) bit[i].store(tmp[i], std::memory_order_relaxed);
+  }
+  // not thread-safe
+  void reset() {
+    for(u32 i = 0; i != bit.size(); ++i) bit[i].store(T{}, std::memory_order_relaxed);
+  }
+  void add(u32 n, const value_type& x) {
+#ifndef NDEBUG
+    if(n >= size()) throw Exception("gsh::ConcurrentFenwickTree::add / Index is out of range.");
+#endif
+    write([&]() {
+      for(u32 i = n + 1, sz = size(); i <= sz; i += (i & -i)) bit[i - 1].fetch_add(x, std::memory_order_relaxed);
+    });
+  }
+  void sub(u32 n, const value_type& x) { add(n, -x); }
+  void inc(u32 n) { add(n, 1); }
+  void dec(u32 n) { add(n, -1); }
+  value_type sum(u32 n) const {
+#ifndef NDEBUG
+    if(n > size()) throw Exception("gsh::ConcurrentFenwickTree::sum / Index is out of range.");
+#endif
+    return read([&]() { return prefix(n); });
+  }
+  value_type sum(u32 l, u32 r) const {
+#ifndef NDEBUG
+    if(l > r || r > size()) throw Exception("gsh::ConcurrentFenwickTree::sum / Invalid range.");
+#endif
+    return read([&]() { return prefix(r) - prefix(l); });
+  }
+  value_type operator[](u32 n) const { return sum(n, n + 1); }
+};
+// Per-thread sharded FenwickTree. Each thread adds into the shard picked by its thread id, so writers on different shards touch disjoint cache lines;
+// reads merge the shards on the fly in O(shards * log n).
+template<class T> class ShardedFenwickTree {
+  static_assert(std::is_arithmetic_v<T> && std::atomic<T>::is_always_lock_free, "gsh::ShardedFenwickTree / T must be a lock-free arithmetic type.");
+  constexpr static u32 line = 64 / sizeof(T) > 0 ? 64 / sizeof(T) : 1;
+  u32 n = 0, shards = 0, stride = 0;
+  Vec<std::atomic<T>> bit;  // shard s owns bit[s * stride, s * stride + n); a spare line separates neighbouring shards
+  static u32 thread_index() {
+    static std::atomic<u32> next{0};
+    thread_local const u32 id = next.fetch_add(1, std::memory_order_relaxed);
+    return id;
+  }
+  T prefix(u32 s, u32 k) const {
+    const std::atomic<T>* p = bit.data() + static_cast<u64>(s) * stride;
+    T res = {};
+    for(u32 i = k; i != 0; i &= i - 1) res += p[i - 1].load(std::memory_order_relaxed);
+    return res;
+  }
+public:
+  using size_type = u32;
+  using difference_type = i32;
+  using value_type = T;
+  ShardedFenwickTree() = default;
+  // shards is lowered if all of them would not fit into one Vec
+  explicit ShardedFenwickTree(u32 n, u32 shards = std::max(1u, std::thread::hardware_concurrency())) : n(n) {
+    const u64 s = (static_cast<u64>(n) + line - 1) / line * line + line;
+#ifndef NDEBUG
+    if(s > 0xffffffff) throw Exception("gsh::ShardedFenwickTree::ShardedFenwickTree / n is too large.");
+#endif
+    stride = s;
+    this->shards = static_cast<u32>(std::clamp<u64>(shards, 1, std::max<u64>(0xffffffff / s, 1)));
+    bit = Vec<std::atomic<T>>(this->shards * stride);
+  }
+  template<class InputIterator> requires std::forward_iterator<InputIterator> ShardedFenwickTree(InputIterator first, InputIterator last, u32 shards = std::max(1u, std::thread::hardware_concurrency())) : ShardedFenwickTree(std::ranges::distance(first, last), shards) {
+    const Vec<T> tmp = internal::FenwickNodes<T>(first, last);
+    for(u32 i = 0; i != n; ++i) bit[i].store(tmp[i], std::memory_order_relaxed);
+  }
+  u32 size() const noexcept { return n; }
+  bool empty() const noexcept { return n == 0; }
+  u32 shard_count() const noexcept { return shards; }
+  // not thread-safe
+  void reset() {
+    for(u32 i = 0; i != bit.size(); ++i) bit[i].store(T{}, std::memory_order_relaxed);
+  }
+  void add(u32 k, const value_type& x) {
+#ifndef NDEBUG
+    if(k >= n) throw Exception("gsh::ShardedFenwickTree::add / Index is out of range.");
+#endif
+    std::atomic<T>* p = bit.data() + static_cast<u64>(thread_index() % shards) * stride;
+    for(u32 i = k + 1; i <= n; i += (i & -i)) p[i - 1].fetch_add(x, std::memory_order_relaxed);
+  }
+  void sub(u32 k, const value_type& x) { add(k, -x); }
+  void inc(u32 k) { add(k, 1); }
+  void dec(u32 k) { add(k, -1); }
+  value_type sum(u32 k) const {
+#ifndef NDEBUG
+    if(k > n) throw Exception("gsh::ShardedFenwickTree::sum / Index is out of range.");
+#endif
+    T res = {};
+    for(u32 s = 0; s != shards; ++s) res += prefix(s, k);
+    return res;
+  }
+  value_type sum(u32 l, u32 r) const {
+#ifndef NDEBUG
+    if(l > r || r > n) throw Exception("gsh::ShardedFenwickTree::sum / Invalid range.");
+#endif
+    T res = {};
+    for(u32 s = 0; s != shards; ++s) res += prefix(s, r) - prefix(s, l);
+    return res;
+  }
+  value_type operator[](u32 k) const { return sum(k, k + 1); }
+};
 }
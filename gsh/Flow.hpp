@@ -0,0 +1,361 @@
+#pragma once
+#include "Exception.hpp"
+#include "Heap.hpp"
+#include "Memory.hpp"
+#include "TypeDef.hpp"
+#include "Vec.hpp"
+#include <limits>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+namespace gsh {
+// highest-label push-relabel with global relabeling and the gap heuristic
+template<class Cap> class MaxFlow {
+public:
+  using size_type = u32;
+  using capacity_type = Cap;
+private:
+  static constexpr u32 npos = 0xffffffffu;
+  struct Arc {
+    u32 to, rev;
+    Cap cap;
+  };
+  u32 n_ = 0;
+  Vec<std::tuple<u32, u32, Cap>> edges_;
+  bool built_ = false;
+  Mem<u32> off_, pos_;
+  Mem<Arc> arcs_;
+  Mem<Cap> excess_;
+  Mem<u32> h_, cur_;
+  Mem<u32> anext_, ahead_;
+  Mem<u32> dnext_, dprev_, dhead_;
+  u32 hi_ = 0, hmax_ = 0, relabel_cnt_ = 0;
+  constexpr void build() {
+    const u32 n = n_, m = edges_.size();
+    off_ = Mem<u32>(n + 1, 0);
+    for(const auto& [u, v, c] : edges_) ++off_[u + 1], ++off_[v + 1];
+    for(u32 i = 0; i != n; ++i) off_[i + 1] += off_[i];
+    arcs_ = Mem<Arc>(2 * m);
+    pos_ = Mem<u32>(m);
+    Mem<u32> p = off_;
+    for(u32 i = 0; i != m; ++i) {
+      const auto& [u, v, c] = edges_[i];
+      const u32 a = p[u]++, b = p[v]++;
+      arcs_[a] = Arc{v, b, c};
+      arcs_[b] = Arc{u, a, Cap{}};
+      pos_[i] = a;
+    }
+    excess_ = Mem<Cap>(n);
+    h_ = Mem<u32>(n), cur_ = Mem<u32>(n);
+    anext_ = Mem<u32>(n), ahead_ = Mem<u32>(n + 1);
+    dnext_ = Mem<u32>(n), dprev_ = Mem<u32>(n), dhead_ = Mem<u32>(n + 1);
+    built_ = true;
+  }
+  constexpr void activate(u32 v) {
+    anext_[v] = ahead_[h_[v]];
+    ahead_[h_[v]] = v;
+    if(hi_ < h_[v]) hi_ = h_[v];
+  }
+  constexpr void dinsert(u32 v) {
+    const u32 k = h_[v];
+    dprev_[v] = npos;
+    dnext_[v] = dhead_[k];
+    if(dhead_[k] != npos) dprev_[dhead_[k]] = v;
+    dhead_[k] = v;
+    if(hmax_ < k) hmax_ = k;
+  }
+  constexpr void derase(u32 v) {
+    const u32 k = h_[v];
+    if(dprev_[v] != npos) dnext_[dprev_[v]] = dnext_[v];
+    else dhead_[k] = dnext_[v];
+    if(dnext_[v] != npos) dprev_[dnext_[v]] = dprev_[v];
+  }
+  // exact distances to sink in the residual graph; vertices that cannot reach it get height n
+  constexpr void global_relabel(u32 sink, u32 skip) {
+    const u32 n = n_;
+    for(u32 v = 0; v != n; ++v) h_[v] = n, cur_[v] = off_[v];
+    for(u32 k = 0; k <= n; ++k) ahead_[k] = dhead_[k] = npos;
+    hi_ = hmax_ = 0;
+    relabel_cnt_ = 0;
+    Mem<u32>& que = anext_;
+    u32 qh = 0, qt = 0;
+    h_[sink] = 0;
+    que[qt++] = sink;
+    while(qh != qt) {
+      const u32 v = que[qh++];
+      for(u32 i = off_[v]; i != off_[v + 1]; ++i) {
+        const Arc& a = arcs_[i];
+        if(h_[a.to] == n && a.to != skip && arcs_[a.rev].cap > Cap{}) h_[a.to] = h_[v] + 1, que[qt++] = a.to;
+      }
+    }
+    for(u32 v = 0; v != n; ++v) {
+      if(h_[v] == n) continue;
+      dinsert(v);
+      if(v != sink && excess_[v] > Cap{}) activate(v);
+    }
+  }
+  constexpr void relabel(u32 v) {
+    const u32 n = n_, k = h_[v];
+    ++relabel_cnt_;
+    derase(v);
+    if(dhead_[k] == npos) {
+      // gap: nothing above k can reach the sink any more
+      for(u32 j = k + 1; j <= hmax_; ++j) {
+        for(u32 x = dhead_[j]; x != npos; x = dnext_[x]) h_[x] = n;
+        dhead_[j] = ahead_[j] = npos;
+      }
+      hmax_ = k - (k != 0);
+      h_[v] = n;
+      return;
+    }
+    u32 nh = n;
+    for(u32 i = off_[v]; i != off_[v + 1]; ++i) {
+      const Arc& a = arcs_[i];
+      if(a.cap > Cap{} && h_[a.to] + 1 < nh) nh = h_[a.to] + 1;
+    }
+    h_[v] = nh;
+    cur_[v] = off_[v];
+    if(nh < n) dinsert(v);
+  }
+  constexpr void discharge(u32 v, u32 sink) {
+    const u32 n = n_;
+    while(excess_[v] > Cap{}) {
+      if(cur_[v] == off_[v + 1]) {
+        relabel(v);
+        if(h_[v] >= n) return;
+        continue;
+      }
+      Arc& a = arcs_[cur_[v]];
+      if(a.cap > Cap{} && h_[v] == h_[a.to] + 1) {
+        const Cap d = a.cap < excess_[v] ? a.cap : excess_[v];
+        if(a.to != sink && excess_[a.to] == Cap{}) activate(a.to);
+        a.cap -= d;
+        arcs_[a.rev].cap += d;
+        excess_[v] -= d;
+        excess_[a.to] += d;
+        if(excess_[v] == Cap{}) return;
+      }
+      ++cur_[v];
+    }
+  }
+  constexpr void run(u32 sink, u32 skip) {
+    global_relabel(sink, skip);
+    while(true) {
+      while(ahead_[hi_] == npos) {
+        if(hi_ == 0) return;
+        --hi_;
+      }
+      const u32 v = ahead_[hi_];
+      ahead_[hi_] = anext_[v];
+      if(h_[v] >= n_ || v == sink || v == skip) continue;
+      discharge(v, sink);
+      if(excess_[v] > Cap{} && h_[v] < n_) activate(v);
+      if(relabel_cnt_ >= n_) global_relabel(sink, skip);
+    }
+  }
+public:
+  constexpr MaxFlow() = default;
+  constexpr explicit MaxFlow(u32 n) : n_(n) {}
+  // edge ids follow the iteration order of g[0], g[1], ...
+  template<class G> requires requires(const G& g) { g.vertex_count(); } constexpr explicit MaxFlow(const G& g) : n_(g.vertex_count()) {
+    edges_.reserve(g.edge_count());
+    for(u32 u = 0; u != n_; ++u) {
+      for(const auto& e : g[u]) add_edge(u, e.to(), static_cast<Cap>(e.weight()));
+    }
+  }
+  constexpr u32 vertex_count() const noexcept { return n_; }
+  constexpr u32 edge_count() const noexcept { return edges_.size(); }
+  constexpr u32 add_edge(u32 from, u32 to, const Cap& cap) {
+#ifndef NDEBUG
+    if(from >= n_ || to >= n_) throw Exception("gsh::MaxFlow::add_edge / The index is out of range. ( from=", from, ", to=", to, ", n=", n_, " )");
+    if constexpr(std::numeric_limits<Cap>::is_signed)
+      if(cap < Cap{}) throw Exception("gsh::MaxFlow::add_edge / The capacity must be non-negative.");
+#endif
+    built_ = false;
+    edges_.emplace_back(from, to, cap);
+    return edges_.size() - 1;
+  }
+  // computes the maximum flow from zero; edge_flow and min_cut refer to the last call
+  constexpr Cap flow(u32 s, u32 t) {
+#ifndef NDEBUG
+    if(s >= n_ || t >= n_ || s == t) throw Exception("gsh::MaxFlow::flow / Invalid source or sink. ( s=", s, ", t=", t, ", n=", n_, " )");
+#endif
+    if(!built_) build();
+    else {
+      for(u32 i = 0; i != edges_.size(); ++i) {
+        Arc& a = arcs_[pos_[i]];
+        a.cap = std::get<2>(edges_[i]);
+        arcs_[a.rev].cap = Cap{};
+      }
+    }
+    for(u32 v = 0; v != n_; ++v) excess_[v] = Cap{};
+    for(u32 i = off_[s]; i != off_[s + 1]; ++i) {
+      Arc& a = arcs_[i];
+      if(a.to == s || a.cap == Cap{}) continue;
+      excess_[a.to] += a.cap;
+      arcs_[a.rev].cap += a.cap;
+      a.cap = Cap{};
+    }
+    run(t, s);
+    const Cap res = excess_[t];
+    // return the excess stranded in the preflow to s
+    run(s, t);
+    return res;
+  }
+  constexpr Cap edge_flow(u32 i) const {
+#ifndef NDEBUG
+    if(i >= edges_.size()) throw Exception("gsh::MaxFlow::edge_flow / The index is out of range. ( i=", i, ", size=", edges_.size(), " )");
+#endif
+    if(!built_) return Cap{};
+    return std::get<2>(edges_[i]) - arcs_[pos_[i]].cap;
+  }
+  // res[v] is true iff v is on the source side of a minimum cut
+  constexpr Vec<bool> min_cut(u32 s) const {
+    Vec<bool> res(n_, false);
+    if(!built_) return res;
+    Vec<u32> que;
+    que.reserve(n_);
+    res[s] = true;
+    que.push_back(s);
+    for(u32 qh = 0; qh != que.size(); ++qh) {
+      const u32 v = que[qh];
+      for(u32 i = off_[v]; i != off_[v + 1]; ++i) {
+        const Arc& a = arcs_[i];
+        if(a.cap > Cap{} && !res[a.to]) res[a.to] = true, que.push_back(a.to);
+      }
+    }
+    return res;
+  }
+};
+// primal-dual with Dijkstra on reduced costs; costs must be non-negative
+template<class Cap, class Cost> class MinCostFlow {
+  static_assert(std::is_signed_v<Cost>, "gsh::MinCostFlow / Cost must be signed: residual arcs carry negated costs.");
+public:
+  using size_type = u32;
+  using capacity_type = Cap;
+  using cost_type = Cost;
+private:
+  static constexpr u32 npos = 0xffffffffu;
+  struct Arc {
+    u32 to, rev;
+    Cap cap;
+    Cost cost;
+  };
+  u32 n_ = 0;
+  Vec<std::tuple<u32, u32, Cap, Cost>> edges_;
+  bool built_ = false;
+  Mem<u32> off_, pos_;
+  Mem<Arc> arcs_;
+  constexpr void build() {
+    const u32 n = n_, m = edges_.size();
+    off_ = Mem<u32>(n + 1, 0);
+    for(const auto& [u, v, c, w] : edges_) ++off_[u + 1], ++off_[v + 1];
+    for(u32 i = 0; i != n; ++i) off_[i + 1] += off_[i];
+    arcs_ = Mem<Arc>(2 * m);
+    pos_ = Mem<u32>(m);
+    Mem<u32> p = off_;
+    for(u32 i = 0; i != m; ++i) {
+      const auto& [u, v, c, w] = edges_[i];
+      const u32 a = p[u]++, b = p[v]++;
+      arcs_[a] = Arc{v, b, c, w};
+      arcs_[b] = Arc{u, a, Cap{}, -w};
+      pos_[i] = a;
+    }
+    built_ = true;
+  }
+public:
+  constexpr MinCostFlow() = default;
+  constexpr explicit MinCostFlow(u32 n) : n_(n) {}
+  // g's weights are (capacity, cost) pairs; edge ids follow the iteration order of g[0], g[1], ...
+  template<class G> requires requires(const G& g) { g.vertex_count(); } constexpr explicit MinCostFlow(const G& g) : n_(g.vertex_count()) {
+    edges_.reserve(g.edge_count());
+    for(u32 u = 0; u != n_; ++u) {
+      for(const auto& e : g[u]) {
+        const auto& [c, w] = e.weight();
+        add_edge(u, e.to(), static_cast<Cap>(c), static_cast<Cost>(w));
+      }
+    }
+  }
+  constexpr u32 vertex_count() const noexcept { return n_; }
+  constexpr u32 edge_count() const noexcept { return edges_.size(); }
+  constexpr u32 add_edge(u32 from, u32 to, const Cap& cap, const Cost& cost) {
+#ifndef NDEBUG
+    if(from >= n_ || to >= n_) throw Exception("gsh::MinCostFlow::add_edge / The index is out of range. ( from=", from, ", to=", to, ", n=", n_, " )");
+    if constexpr(std::numeric_limits<Cap>::is_signed)
+      if(cap < Cap{}) throw Exception("gsh::MinCostFlow::add_edge / The capacity must be non-negative.");
+    if(cost < Cost{}) throw Exception("gsh::MinCostFlow::add_edge / The cost must be non-negative.");
+#endif
+    built_ = false;
+    edges_.emplace_back(from, to, cap, cost);
+    return edges_.size() - 1;
+  }
+  constexpr std::pair<Cap, Cost> flow(u32 s, u32 t) { return flow(s, t, std::numeric_limits<Cap>::max()); }
+  // sends at most limit units from zero flow; returns (flow, cost)
+  constexpr std::pair<Cap, Cost> flow(u32 s, u32 t, const Cap& limit) {
+#ifndef NDEBUG
+    if(s >= n_ || t >= n_ || s == t) throw Exception("gsh::MinCostFlow::flow / Invalid source or sink. ( s=", s, ", t=", t, ", n=", n_, " )");
+#endif
+    const u32 n = n_;
+    if(!built_) build();
+    else {
+      for(u32 i = 0; i != edges_.size(); ++i) {
+        Arc& a = arcs_[pos_[i]];
+        a.cap = std::get<2>(edges_[i]);
+        arcs_[a.rev].cap = Cap{};
+      }
+    }
+    constexpr Cost inf = std::numeric_limits<Cost>::max();
+    Mem<Cost> dual(n, Cost{}), dist(n);
+    Mem<u32> prev(n);
+    Mem<u8> vis(n);
+    Heap<std::pair<Cost, u32>, decltype([](const auto& a, const auto& b) { return a.first < b.first; })> que;
+    Cap fl{};
+    Cost cs{};
+    while(fl < limit) {
+      for(u32 v = 0; v != n; ++v) dist[v] = inf, vis[v] = 0;
+      que.clear();
+      dist[s] = Cost{};
+      que.emplace(Cost{}, s);
+      while(!que.empty()) {
+        const u32 v = que.min().second;
+        que.pop_min();
+        if(vis[v]) continue;
+        vis[v] = 1;
+        if(v == t) break;
+        for(u32 i = off_[v]; i != off_[v + 1]; ++i) {
+          const Arc& a = arcs_[i];
+          if(a.cap == Cap{}) continue;
+          const Cost nd = dist[v] + (a.cost - dual[a.to] + dual[v]);
+          if(nd < dist[a.to]) {
+            dist[a.to] = nd;
+            prev[a.to] = i;
+            que.emplace(nd, a.to);
+          }
+        }
+      }
+      if(!vis[t]) break;
+      for(u32 v = 0; v != n; ++v)
+        if(vis[v]) dual[v] -= dist[t] - dist[v];
+      Cap c = limit - fl;
+      for(u32 v = t; v != s; v = arcs_[arcs_[prev[v]].rev].to) {
+        if(arcs_[prev[v]].cap < c) c = arcs_[prev[v]].cap;
+      }
+      for(u32 v = t; v != s; v = arcs_[arcs_[prev[v]].rev].to) {
+        Arc& a = arcs_[prev[v]];
+        a.cap -= c;
+        arcs_[a.rev].cap += c;
+      }
+      fl += c;
+      cs += c * -dual[s];
+    }
+    return {fl, cs};
+  }
+  constexpr Cap edge_flow(u32 i) const {
+#ifndef NDEBUG
+    if(i >= edges_.size()) throw Exception("gsh::MinCostFlow::edge_flow / The index is out of range. ( i=", i, ", size=", edges_.size(), " )");
+#endif
+    if(!built_) return Cap{};
+    return std::get<2>(edges_[i]) - arcs_[pos_[i]].cap;
+  }
+};
+}
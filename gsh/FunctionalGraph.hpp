@@ -3,10 +3,15 @@
 #include "Memory.hpp"
 #include "TypeDef.hpp"
 #include "Vec.hpp"
+#include "internal/Parallel.hpp"
 #include <concepts>
 #include <iterator>
 #include <ranges>
+#include <type_traits>
 namespace gsh {
+// Doubling: 64 levels of n entries, jump in O(log step)
+// Compact: skew-binary jump pointers on the in-forest plus the cycle order, jump in O(log n) with a few words per vertex
+enum class FunctionalGraphTable { Doubling, Compact };
 class FunctionalGraph {
 public:
   using size_type = u32;
@@ -14,19 +19,30 @@ public:
 private:
   static constexpr u32 log_ = 64;
   size_type n_ = 0;
+  FunctionalGraphTable table_ = FunctionalGraphTable::Doubling;
   Mem<size_type> to_;
   Mem<size_type> comp_;
   Mem<size_type> entry_;
   Mem<size_type> depth_;
   Mem<size_type> cycle_pos_;
   Mem<size_type> cycle_len_;
+  Mem<size_type> cycle_start_; // cycle_[cycle_start_[c] + i] is the i-th vertex of the cycle of component c
+  Mem<size_type> cycle_;
   Mem<size_type> up_;
+  Mem<size_type> skip_; // an ancestor in the in-forest; following skip_ and to_ greedily reaches any depth in O(log n) steps
   constexpr size_type up_at(const u32 k, const size_type v) const noexcept { return up_[k * n_ + v]; }
   constexpr size_type& up_at(const u32 k, const size_type v) noexcept { return up_[k * n_ + v]; }
   template<class E> static constexpr size_type edge_to(const E& e) {
     if constexpr(requires { e.to(); }) return static_cast<size_type>(e.to());
     else return static_cast<size_type>(e);
   }
+  // step >= depth_[v]: v has reached its cycle
+  constexpr size_type cycle_jump(const size_type v, const u64 step) const {
+    const size_type c = comp_[v], len = cycle_len_[c];
+    const size_type r = static_cast<size_type>((step - depth_[v]) % len);
+    const size_type p = cycle_pos_[entry_[v]] + r;
+    return cycle_[cycle_start_[c] + (p < len ? p : p - len)];
+  }
   template<u32 K> constexpr size_type jump_impl(size_type v, const u64 step) const {
     if constexpr(K == log_) {
       return v;
@@ -42,7 +58,10 @@ private:
       depth_.clear();
       cycle_pos_.clear();
       cycle_len_.clear();
+      cycle_start_.clear();
+      cycle_.clear();
       up_.clear();
+      skip_.clear();
       return;
     }
     Mem<size_type> indeg(n_, 0);
@@ -68,31 +87,30 @@ private:
     entry_ = Mem<size_type>(n_, npos);
     depth_ = Mem<size_type>(n_, 0);
     cycle_pos_ = Mem<size_type>(n_, npos);
-    Vec<size_type> cycle_len_vec;
+    Vec<size_type> cycle_start_vec;
+    cycle_ = Mem<size_type>(n_ - order.size());
     // assign cycle nodes
-    size_type comp_cnt = 0;
+    size_type comp_cnt = 0, cycle_cnt = 0;
     for(size_type v = 0; v < n_; ++v) {
       if(removed[v]) continue;
       if(comp_[v] != npos) continue;
-      Vec<size_type> cyc;
-      size_type cur = v;
+      cycle_start_vec.push_back(cycle_cnt);
+      size_type cur = v, i = 0;
       do {
-        cyc.push_back(cur);
+        cycle_[cycle_cnt++] = cur;
+        comp_[cur] = comp_cnt;
+        entry_[cur] = cur;
+        depth_[cur] = 0;
+        cycle_pos_[cur] = i++;
         cur = to_[cur];
       } while(cur != v);
-      const size_type len = cyc.size();
-      for(size_type i = 0; i < len; ++i) {
-        const size_type x = cyc[i];
-        comp_[x] = comp_cnt;
-        entry_[x] = x;
-        depth_[x] = 0;
-        cycle_pos_[x] = i;
-      }
-      cycle_len_vec.push_back(len);
       ++comp_cnt;
     }
+    cycle_start_vec.push_back(cycle_cnt);
     cycle_len_ = Mem<size_type>(comp_cnt);
-    for(size_type i = 0; i < comp_cnt; ++i) cycle_len_[i] = cycle_len_vec[i];
+    cycle_start_ = Mem<size_type>(comp_cnt + 1);
+    for(size_type i = 0; i < comp_cnt; ++i) cycle_len_[i] = cycle_start_vec[i + 1] - cycle_start_vec[i];
+    for(size_type i = 0; i <= comp_cnt; ++i) cycle_start_[i] = cycle_start_vec[i];
     // assign non-cycle nodes in reverse topological order
     for(size_type idx = order.size(); idx != 0; --idx) {
       const size_type v = order[idx - 1];
@@ -101,6 +119,19 @@ private:
       entry_[v] = entry_[u];
       depth_[v] = depth_[u] + 1;
     }
+    if(table_ == FunctionalGraphTable::Compact) {
+      up_.clear();
+      // skew-binary jump pointers (Myers): the jump lengths along any path follow the pattern 1, 1, 3, 1, 1, 3, 7, ...
+      skip_ = Mem<size_type>(n_);
+      for(size_type i = 0; i != cycle_cnt; ++i) skip_[cycle_[i]] = cycle_[i];
+      for(size_type idx = order.size(); idx != 0; --idx) {
+        const size_type v = order[idx - 1];
+        const size_type p = to_[v], j = skip_[p];
+        skip_[v] = depth_[p] - depth_[j] == depth_[j] - depth_[skip_[j]] ? skip_[j] : p;
+      }
+      return;
+    }
+    skip_.clear();
     // doubling table
     up_ = Mem<size_type>(n_ * log_);
     for(size_type v = 0; v < n_; ++v) up_at(0, v) = to_[v];
@@ -110,8 +141,8 @@ private:
   }
 public:
   constexpr FunctionalGraph() = default;
-  template<std::ranges::forward_range R> constexpr explicit FunctionalGraph(R&& successor) { assign_successor(std::forward<R>(successor)); }
-  template<std::forward_iterator It, std::sentinel_for<It> Sent> constexpr FunctionalGraph(It first, Sent last) { assign_successor(first, last); }
+  template<std::ranges::forward_range R> constexpr explicit FunctionalGraph(R&& successor, FunctionalGraphTable table = FunctionalGraphTable::Doubling) : table_(table) { assign_successor(std::forward<R>(successor)); }
+  template<std::forward_iterator It, std::sentinel_for<It> Sent> constexpr FunctionalGraph(It first, Sent last, FunctionalGraphTable table = FunctionalGraphTable::Doubling) : table_(table) { assign_successor(first, last); }
   // successor[v] = next vertex
   template<std::ranges::forward_range R> requires std::convertible_to<std::ranges::range_reference_t<R>, size_type> constexpr void assign_successor(R&& successor) { assign_successor(std::ranges::begin(successor), std::ranges::end(successor)); }
   template<std::forward_iterator It, std::sentinel_for<It> Sent> requires std::convertible_to<std::iter_reference_t<It>, size_type> constexpr void assign_successor(It first, Sent last) {
@@ -127,6 +158,10 @@ public:
 #endif
     build_tables();
   }
+  template<std::ranges::forward_range R> requires std::convertible_to<std::ranges::range_reference_t<R>, size_type> constexpr void assign_successor(R&& successor, FunctionalGraphTable table) {
+    table_ = table;
+    assign_successor(std::forward<R>(successor));
+  }
   // out_edges[v] is a range with exactly one outgoing edge
   template<std::ranges::forward_range G> requires (!std::convertible_to<std::ranges::range_reference_t<G>, size_type>) && std::ranges::range<std::ranges::range_reference_t<G>> constexpr void assign_out_edges(G&& out_edges) {
     const size_type n = static_cast<size_type>(std::ranges::distance(std::ranges::begin(out_edges), std::ranges::end(out_edges)));
@@ -152,6 +187,10 @@ public:
     }
     build_tables();
   }
+  template<std::ranges::forward_range G> requires (!std::convertible_to<std::ranges::range_reference_t<G>, size_type>) && std::ranges::range<std::ranges::range_reference_t<G>> constexpr void assign_out_edges(G&& out_edges, FunctionalGraphTable table) {
+    table_ = table;
+    assign_out_edges(std::forward<G>(out_edges));
+  }
   constexpr void clear() {
     n_ = 0;
     to_.clear();
@@ -160,10 +199,14 @@ public:
     depth_.clear();
     cycle_pos_.clear();
     cycle_len_.clear();
+    cycle_start_.clear();
+    cycle_.clear();
     up_.clear();
+    skip_.clear();
   }
   constexpr size_type size() const noexcept { return n_; }
   constexpr bool empty() const noexcept { return n_ == 0; }
+  constexpr FunctionalGraphTable table() const noexcept { return table_; }
   constexpr size_type next(const size_type v) const {
 #ifndef NDEBUG
     if(v >= n_) throw Exception("FunctionalGraph::next: v is out of range ( v=", v, ", n=", n_, " )");
@@ -172,12 +215,71 @@ public:
     return to_[v];
   }
   // vertex after `step` transitions
-  constexpr size_type jump(const size_type v, const u64 step) const {
+  constexpr size_type jump(size_type v, const u64 step) const {
 #ifndef NDEBUG
     if(v >= n_) throw Exception("FunctionalGraph::jump: v is out of range ( v=", v, ", n=", n_, " )");
-    if(up_.empty()) throw Exception("FunctionalGraph::jump: not initialized");
+    if(to_.empty()) throw Exception("FunctionalGraph::jump: not initialized");
+#endif
+    if(table_ == FunctionalGraphTable::Doubling) return jump_impl<0>(v, step);
+    if(step < depth_[v]) {
+      const size_type d = depth_[v] - static_cast<size_type>(step);
+      while(depth_[v] != d) v = depth_[skip_[v]] >= d ? skip_[v] : to_[v];
+      return v;
+    }
+    return cycle_jump(v, step);
+  }
+private:
+  // the queries [first, last) of jump_many
+  template<class VI, class SI, class Out> constexpr void jump_range(VI vi, SI si, Out out, size_type first, size_type last) const {
+    constexpr size_type group = 16;
+    size_type cur[group], target[group];
+    u64 st[group];
+    for(size_type base = first; base < last; base += group) {
+      const size_type g = last - base < group ? last - base : group;
+      for(size_type j = 0; j != g; ++j) cur[j] = static_cast<size_type>(vi[base + j]), st[j] = static_cast<u64>(si[base + j]);
+      if(table_ == FunctionalGraphTable::Doubling) {
+        u64 all = 0;
+        for(size_type j = 0; j != g; ++j) all |= st[j];
+        for(u32 k = 0; k != log_ && (all >> k) != 0; ++k) {
+          for(size_type j = 0; j != g; ++j)
+            if((st[j] >> k) & 1) cur[j] = up_at(k, cur[j]);
+        }
+      } else {
+        size_type active = 0;
+        for(size_type j = 0; j != g; ++j) {
+          if(st[j] == 0) target[j] = npos;
+          else if(st[j] < depth_[cur[j]]) target[j] = depth_[cur[j]] - static_cast<size_type>(st[j]), ++active;
+          else cur[j] = cycle_jump(cur[j], st[j]), target[j] = npos;
+        }
+        while(active != 0) {
+          for(size_type j = 0; j != g; ++j) {
+            if(target[j] == npos) continue;
+            const size_type x = cur[j], s = skip_[x];
+            cur[j] = depth_[s] >= target[j] ? s : to_[x];
+            if(depth_[cur[j]] == target[j]) target[j] = npos, --active;
+          }
+        }
+      }
+      for(size_type j = 0; j != g; ++j) out[base + j] = cur[j];
+    }
+  }
+public:
+  // out[i] = jump(v[i], step[i]); queries advance in lockstep groups so that their random loads overlap
+  // with threads > 1 the batch is cut into contiguous parts, one per thread
+  template<std::ranges::random_access_range R1, std::ranges::random_access_range R2, std::random_access_iterator Out> constexpr void jump_many(const R1& v, const R2& step, Out out, u32 threads = internal::DefaultThreads()) const {
+    const size_type q = std::ranges::size(v);
+    const auto vi = std::ranges::begin(v);
+    const auto si = std::ranges::begin(step);
+#ifndef NDEBUG
+    if(std::ranges::size(step) != q) throw Exception("FunctionalGraph::jump_many: the sizes of v and step differ ( v=", q, ", step=", std::ranges::size(step), " )");
+    if(to_.empty() && q != 0) throw Exception("FunctionalGraph::jump_many: not initialized");
+    for(size_type i = 0; i != q; ++i)
+      if(static_cast<size_type>(vi[i]) >= n_) throw Exception("FunctionalGraph::jump_many: v is out of range ( v=", static_cast<size_type>(vi[i]), ", n=", n_, " )");
 #endif
-    return jump_impl<0>(v, step);
+    if(std::is_constant_evaluated()) threads = 1;
+    else if(threads != 1) threads = internal::ThreadsFor(q, threads, 1 << 14);
+    if(threads == 1) jump_range(vi, si, out, 0, q);
+    else internal::ParallelChunks(threads, q, [&](u32, u64 first, u64 last) { jump_range(vi, si, out, first, last); });
   }
   constexpr bool on_cycle(const size_type v) const {
 #ifndef NDEBUG
@@ -250,6 +352,54 @@ public:
     const size_type len = cycle_len_[comp_[m]];
     return 1 + (step - static_cast<u64>(d)) / static_cast<u64>(len);
   }
+private:
+  // the queries [first, last) of visit_count_inclusive_many
+  template<class VI, class SI, class MI, class Out> constexpr void visit_count_range(VI vi, SI si, MI mi, Out out, size_type first, size_type last) const {
+    constexpr size_type block = 256;
+    size_type from[block], landed[block], idx[block];
+    u64 len[block];
+    for(size_type base = first; base < last; base += block) {
+      const size_type b = last - base < block ? last - base : block;
+      size_type cnt = 0;
+      for(size_type j = 0; j != b; ++j) {
+        const size_type a = static_cast<size_type>(vi[base + j]), t = static_cast<size_type>(mi[base + j]);
+        if(comp_[a] == comp_[t] && depth_[a] >= depth_[t]) from[cnt] = a, len[cnt] = depth_[a] - depth_[t], idx[cnt++] = j;
+      }
+      jump_range(from, len, landed, 0, cnt);
+      for(size_type j = 0, k = 0; j != b; ++j) {
+        const size_type a = static_cast<size_type>(vi[base + j]), t = static_cast<size_type>(mi[base + j]);
+        const u64 s = static_cast<u64>(si[base + j]);
+        size_type d = npos;
+        if(k != cnt && idx[k] == j && landed[k++] == t) d = depth_[a] - depth_[t];
+        else if(comp_[a] == comp_[t] && depth_[t] == 0) {
+          const size_type c = comp_[a], l = cycle_len_[c];
+          d = depth_[a] + (cycle_pos_[t] + l - cycle_pos_[entry_[a]]) % l;
+        }
+        if(d == npos || static_cast<u64>(d) > s) out[base + j] = 0;
+        else if(depth_[t] != 0) out[base + j] = 1;
+        else out[base + j] = 1 + (s - d) / cycle_len_[comp_[t]];
+      }
+    }
+  }
+public:
+  // out[i] = visit_count_inclusive(v[i], step[i], m[i]); the jumps behind dist are batched as in jump_many, and split over threads the same way
+  template<std::ranges::random_access_range R1, std::ranges::random_access_range R2, std::ranges::random_access_range R3, std::random_access_iterator Out> constexpr void visit_count_inclusive_many(const R1& v, const R2& step, const R3& m, Out out, u32 threads = internal::DefaultThreads()) const {
+    const size_type q = std::ranges::size(v);
+    const auto vi = std::ranges::begin(v);
+    const auto si = std::ranges::begin(step);
+    const auto mi = std::ranges::begin(m);
+#ifndef NDEBUG
+    if(std::ranges::size(step) != q || std::ranges::size(m) != q) throw Exception("FunctionalGraph::visit_count_inclusive_many: the sizes of v, step and m differ ( v=", q, ", step=", std::ranges::size(step), ", m=", std::ranges::size(m), " )");
+    for(size_type i = 0; i != q; ++i) {
+      const size_type a = static_cast<size_type>(vi[i]), t = static_cast<size_type>(mi[i]);
+      if(a >= n_ || t >= n_) throw Exception("FunctionalGraph::visit_count_inclusive_many: vertex is out of range ( v=", a, ", m=", t, ", n=", n_, " )");
+    }
+#endif
+    if(std::is_constant_evaluated()) threads = 1;
+    else if(threads != 1) threads = internal::ThreadsFor(q, threads, 1 << 14);
+    if(threads == 1) visit_count_range(vi, si, mi, out, 0, q);
+    else internal::ParallelChunks(threads, q, [&](u32, u64 first, u64 last) { visit_count_range(vi, si, mi, out, first, last); });
+  }
   // count visits of vertex m in the sequence f^1(v), f^2(v), ..., f^step(v)
   constexpr u64 visit_count_exclusive(const size_type v, const u64 step, const size_type m) const {
     if(step == 0) return 0;
@@ -7,7 +7,12 @@
 #include "TypeDef.hpp"
 #include "UnionFind.hpp"
 #include "Vec.hpp"
+#include "internal/Parallel.hpp"
 #include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <bit>
+#include <cmath>
 #include <cstddef>
 #include <functional>
 #include <iterator>
@@ -17,6 +22,9 @@
 #include <type_traits>
 #include <utility>
 #include <variant>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 namespace gsh {
 template<class W = std::monostate> class Edge {
   u32 t = 0;
@@ -59,6 +67,36 @@ template<std::size_t M, class W> requires (M < 2) struct tuple_element<M, const
 };
 }
 namespace gsh {
+// new id i holds the old vertex order[i]
+class VertexRelabeling {
+  Mem<u32> to_new_, to_old_;
+public:
+  constexpr VertexRelabeling() = default;
+  constexpr explicit VertexRelabeling(const Vec<u32>& order) : to_new_(order.size()), to_old_(order.size()) {
+    for(u32 i = 0; i != order.size(); ++i) {
+#ifndef NDEBUG
+      if(order[i] >= order.size()) throw Exception("gsh::VertexRelabeling::VertexRelabeling / The order is not a permutation. ( order[", i, "]=", order[i], " )");
+#endif
+      to_old_[i] = order[i];
+      to_new_[order[i]] = i;
+    }
+  }
+  constexpr u32 size() const noexcept { return to_new_.size(); }
+  constexpr u32 to_new(u32 v) const { return to_new_[v]; }
+  constexpr u32 to_old(u32 v) const { return to_old_[v]; }
+  // reorders per-vertex data indexed by old ids into new ids
+  template<class T> constexpr Vec<T> apply(const Vec<T>& x) const {
+    Vec<T> res(x.size());
+    for(u32 i = 0; i != x.size(); ++i) res[i] = x[to_old_[i]];
+    return res;
+  }
+  // maps per-vertex results of the relabeled graph back to old ids
+  template<class T> constexpr Vec<T> restore(const Vec<T>& x) const {
+    Vec<T> res(x.size());
+    for(u32 i = 0; i != x.size(); ++i) res[to_old_[i]] = x[i];
+    return res;
+  }
+};
 namespace internal {
 template<class W, bool IsConst> class AdjacencyList : public ViewInterface<AdjacencyList<W, IsConst>, Edge<W>> {
   constexpr static u32 npos = 0xffffffffu;
@@ -148,6 +186,119 @@ public:
     return adjacency_list<true>(storage.begin(), tail[v]);
   }
   constexpr void reserve(u32 m) { storage.reserve(m); }
+  // the bucketed build of assign_arcs with the arcs split over threads: each thread scatters a contiguous part of the input behind the
+  // parts of lower threads, so every bucket keeps the input order; the buckets are then counted and placed independently
+  template<class From, class To, class Weight> void assign_arcs_parallel(u32 n, u32 m, u32 shift, u32 threads, From& from, To& to, Weight& w) {
+    const u32 nb = ((n - 1) >> shift) + 1;
+    Mem<u32> bpos(static_cast<u64>(threads) * nb, 0), bstart(nb + 1);
+    internal::ParallelChunks(threads, m, [&](u32 t, u64 first, u64 last) {
+      u32* cnt = bpos.data() + static_cast<u64>(t) * nb;
+      for(u64 i = first; i != last; ++i) ++cnt[from(i) >> shift];
+    });
+    u32 sum = 0;
+    for(u32 b = 0; b != nb; ++b) {
+      bstart[b] = sum;
+      for(u32 t = 0; t != threads; ++t) {
+        const u32 c = bpos[static_cast<u64>(t) * nb + b];
+        bpos[static_cast<u64>(t) * nb + b] = sum;
+        sum += c;
+      }
+    }
+    bstart[nb] = sum;
+    Mem<u32> bfrom(m), bto(m);
+    using buf_weight = std::conditional_t<is_weighted, W, u8>;
+    Mem<buf_weight> bw(is_weighted ? m : 0);
+    internal::ParallelChunks(threads, m, [&](u32 t, u64 first, u64 last) {
+      u32* cur = bpos.data() + static_cast<u64>(t) * nb;
+      for(u64 i = first; i != last; ++i) {
+        const u32 v = from(i), k = cur[v >> shift]++;
+        bfrom[k] = v, bto[k] = to(i);
+        if constexpr(is_weighted) bw[k] = w(i);
+      }
+    });
+    storage.clear();
+    storage.resize(m, {Edge<W>(0), npos});
+    // off[v + 1] and pos[v + 1] are only touched by the bucket of v
+    Mem<u32> off(n + 1), pos(n + 1);
+    internal::ParallelChunks(threads, nb, [&](u32, u64 first, u64 last) {
+      for(u64 b = first; b != last; ++b) {
+        const u32 lo = b << shift, hi = std::min<u64>((b + 1) << shift, n);
+        for(u32 v = lo; v != hi; ++v) off[v + 1] = 0;
+        for(u32 k = bstart[b]; k != bstart[b + 1]; ++k) ++off[bfrom[k] + 1];
+        for(u32 v = lo, sum = bstart[b]; v != hi; ++v) {
+          if(off[v + 1] != 0) tail[v] = sum;
+          sum += off[v + 1];
+          off[v + 1] = pos[v + 1] = sum;
+        }
+        for(u32 k = bstart[b]; k != bstart[b + 1]; ++k) {
+          const u32 v = bfrom[k], j = --pos[v + 1];
+          const u32 next = j + 1 == off[v + 1] ? npos : j + 1;
+          if constexpr(is_weighted) storage[j] = {Edge<W>(bto[k], bw[k]), next};
+          else storage[j] = {Edge<W>(bto[k]), next};
+        }
+      }
+    });
+  }
+  // equivalent to connect(from(i), to(i)[, w(i)]) for i = 0, ..., m - 1, built with counting passes
+  template<class From, class To, class Weight> constexpr void assign_arcs(u32 n, u32 m, From&& from, To&& to, Weight&& w) {
+    tail.assign(n, npos);
+    // scattering straight into storage misses the cache on every arc once it is large,
+    // so first split the arcs into coarse buckets of consecutive vertices
+    u32 shift = 0;
+    while((n >> shift) > 1024) ++shift;
+    const bool bucketed = m >= (1u << 20) && shift != 0;
+    const u32 threads = !bucketed || std::is_constant_evaluated() ? 1 : internal::ThreadsFor(m, internal::DefaultThreads(), 1 << 18);
+    if(threads > 1) {
+#ifndef NDEBUG
+      for(u32 i = 0; i != m; ++i) {
+        if(from(i) >= n || to(i) >= n) [[unlikely]]
+          throw Exception("gsh::graph_format::CRS::assign_arcs / The index is out of range. ( from=", from(i), ", to=", to(i), ", size=", n, " )");
+      }
+#endif
+      assign_arcs_parallel(n, m, shift, threads, from, to, w);
+      return;
+    }
+    Mem<u32> off(n + 1, 0);
+    for(u32 i = 0; i != m; ++i) {
+#ifndef NDEBUG
+      if(from(i) >= n || to(i) >= n) [[unlikely]]
+        throw Exception("gsh::graph_format::CRS::assign_arcs / The index is out of range. ( from=", from(i), ", to=", to(i), ", size=", n, " )");
+#endif
+      ++off[from(i) + 1];
+    }
+    for(u32 v = 0; v != n; ++v) off[v + 1] += off[v];
+    for(u32 v = 0; v != n; ++v)
+      if(off[v] != off[v + 1]) tail[v] = off[v];
+    storage.clear();
+    storage.resize(m, {Edge<W>(0), npos});
+    Mem<u32> pos = off;
+    auto place = [&](u32 v, u32 t, auto&& x) {
+      const u32 j = --pos[v + 1];
+      const u32 next = j + 1 == off[v + 1] ? npos : j + 1;
+      if constexpr(is_weighted) storage[j] = {Edge<W>(t, x), next};
+      else storage[j] = {Edge<W>(t), next};
+    };
+    if(!bucketed) {
+      for(u32 i = 0; i != m; ++i) place(from(i), to(i), w(i));
+      return;
+    }
+    const u32 nb = ((n - 1) >> shift) + 1;
+    Mem<u32> boff(nb + 1, 0);
+    for(u32 b = 0; b != nb; ++b) boff[b + 1] = off[std::min((b + 1) << shift, n)];
+    Mem<u32> bpos = boff;
+    Mem<u32> bfrom(m), bto(m);
+    using buf_weight = std::conditional_t<is_weighted, W, u8>;
+    Mem<buf_weight> bw(is_weighted ? m : 0);
+    for(u32 i = m; i--;) {
+      const u32 v = from(i), k = --bpos[(v >> shift) + 1];
+      bfrom[k] = v, bto[k] = to(i);
+      if constexpr(is_weighted) bw[k] = w(i);
+    }
+    for(u32 k = 0; k != m; ++k) {
+      if constexpr(is_weighted) place(bfrom[k], bto[k], bw[k]);
+      else place(bfrom[k], bto[k], 0);
+    }
+  }
 };
 template<class WTT> class ShortestPathResult {
   template<class D, class W> friend class GraphInterface;
@@ -192,9 +343,32 @@ public:
     return res;
   }
 };
+class Condensation {
+  ConnectedComponents scc_;
+  Mem<u32> off_, to_;
+public:
+  constexpr Condensation() = default;
+  constexpr Condensation(ConnectedComponents&& scc, Mem<u32>&& off, Mem<u32>&& to) : scc_(std::move(scc)), off_(std::move(off)), to_(std::move(to)) {}
+  constexpr const ConnectedComponents& components() const noexcept { return scc_; }
+  constexpr u32 vertex_count() const noexcept { return scc_.size(); }
+  constexpr u32 edge_count() const noexcept { return to_.size(); }
+  constexpr auto operator[](u32 cid) const noexcept { return Subrange(to_.data() + off_[cid], to_.data() + off_[cid + 1]); }
+};
 template<class D, class W> class GraphInterface {
   constexpr D& derived() noexcept { return *static_cast<D*>(this); }
   constexpr const D& derived() const noexcept { return *static_cast<const D*>(this); }
+protected:
+  // copies the adjacency into CSR form in a single pass, keeping the iteration order
+  constexpr void flat_adjacency(Mem<u32>& off, Vec<u32>& to) const {
+    const u32 n = derived().vertex_count();
+    off = Mem<u32>(n + 1);
+    to.clear();
+    for(u32 u = 0; u != n; ++u) {
+      off[u] = to.size();
+      for(const auto& e : derived()[u]) to.push_back(e.to());
+    }
+    off[n] = to.size();
+  }
 public:
   using edge_type = Edge<W>;
   using weight_type = typename edge_type::weight_type;
@@ -280,6 +454,208 @@ public:
     }
     return res;
   }
+  // Delta-stepping. Edges lighter than delta are relaxed repeatedly inside a bucket, heavier ones once when the bucket is settled.
+  // delta == W2{} selects max_weight / average_degree; delta is raised if needed so that at most 4096 buckets are live, and they are reused cyclically.
+  // With threads > 1 every bucket is relaxed in parallel with thread-local buckets. Weights must be non-negative.
+  template<class W2 = weight_type> ShortestPathResult<W2> shortest_path_delta_stepping(u32 s, W2 delta = W2{}, u32 t = 0xffffffff, u32 threads = internal::DefaultThreads()) const {
+    const auto& g = derived();
+    const u32 n = g.vertex_count();
+    const W2 inf = std::numeric_limits<W2>::max();
+    ShortestPathResult<W2> res(inf, n);
+    if(n == 0) return res;
+    Mem<u32> off(n + 1), light_end(n);
+    u32 m = 0;
+    for(u32 v = 0; v != n; ++v) {
+      off[v] = m;
+      m += std::ranges::size(g[v]);
+    }
+    off[n] = m;
+    threads = internal::ThreadsFor(m, threads, 1 << 16);
+    // runs f(th, first, last) on vertex ranges holding about m / threads edges each
+    auto by_edges = [&](auto&& f) {
+      auto bound = [&](u64 e) { return static_cast<u32>(std::lower_bound(off.data(), off.data() + n, e) - off.data()); };
+      internal::ParallelChunks(threads, m, [&](u32 th, u64 first, u64 last) { f(th, bound(first), th + 1 == threads ? n : bound(last)); });
+    };
+    Mem<u32> to(m);
+    Mem<W2> wt(m);
+    Mem<W2> part_max(threads, W2{});
+    by_edges([&](u32 th, u32 first, u32 last) {
+      W2 mx{};
+      for(u32 v = first; v != last; ++v) {
+        for(u32 i = off[v]; const auto& e : g[v]) {
+          const W2 w = static_cast<W2>(e.weight());
+          if(mx < w) mx = w;
+          to[i] = e.to(), wt[i] = w, ++i;
+        }
+      }
+      part_max[th] = mx;
+    });
+    W2 max_w{};
+    for(u32 th = 0; th != threads; ++th) max_w = std::max(max_w, part_max[th]);
+    {
+      // computed in double: max_w * n overflows W2
+      const double mw = static_cast<double>(max_w);
+      double d = delta == W2{} ? (m == 0 ? 1.0 : mw * n / m) : static_cast<double>(delta);
+      if(!(d > 0)) d = 1.0;
+      d = std::min(std::max(d, mw / 4096), std::max(mw, 1.0));
+      if constexpr(std::is_integral_v<W2>) delta = static_cast<W2>(std::max(std::ceil(d), 1.0));
+      else delta = static_cast<W2>(d);
+    }
+    by_edges([&](u32, u32 first, u32 last) {
+      for(u32 v = first; v != last; ++v) {
+        u32 l = off[v], r = off[v + 1];
+        while(l != r) {
+          if(wt[l] < delta) ++l;
+          else {
+            --r;
+            std::swap(to[l], to[r]);
+            std::swap(wt[l], wt[r]);
+          }
+        }
+        light_end[v] = l;
+      }
+    });
+    auto bucket_id = [&](const W2& d) { return static_cast<u64>(d / delta); };
+    const u32 nb = static_cast<u32>(bucket_id(max_w)) + 2;
+    Mem<u8> settled(n, 0);
+    auto& dist = res.dist_;
+    auto& prev = res.prev_;
+    dist[s] = W2{};
+    if(threads == 1) {
+      Vec<Vec<u32>> buckets(nb);
+      Vec<u32> cur, settled_list;
+      u64 remaining = 0;
+      auto relax = [&](u32 v, u32 u, const W2& nd) {
+        if(!(nd < dist[u])) return;
+        dist[u] = nd;
+        prev[u] = v;
+        buckets[bucket_id(nd) % nb].push_back(u);
+        ++remaining;
+      };
+      buckets[0].push_back(s);
+      remaining = 1;
+      for(u64 i = 0; remaining != 0; ++i) {
+        Vec<u32>& b = buckets[i % nb];
+        if(b.empty()) continue;
+        settled_list.clear();
+        while(!b.empty()) {
+          remaining -= b.size();
+          cur.clear();
+          cur.swap(b);
+          for(const u32 v : cur) {
+            if(bucket_id(dist[v]) != i) continue;
+            if(!settled[v]) settled[v] = 1, settled_list.push_back(v);
+            for(u32 k = off[v]; k != light_end[v]; ++k) relax(v, to[k], dist[v] + wt[k]);
+          }
+        }
+        for(const u32 v : settled_list) {
+          for(u32 k = light_end[v]; k != off[v + 1]; ++k) relax(v, to[k], dist[v] + wt[k]);
+        }
+        if(t < n && settled[t]) break;
+      }
+      return res;
+    }
+    // every thread owns a full set of buckets; a phase is split evenly over the union of the threads' lists
+    struct alignas(64) Local {
+      Vec<Vec<u32>> bucket;
+      Vec<u32> cur, settled;
+      u64 pending = 0;
+    };
+    Vec<Local> local(threads);
+    for(Local& L : local) L.bucket = Vec<Vec<u32>>(nb);
+    local[0].bucket[0].push_back(s);
+    local[0].pending = 1;
+    Mem<u64> light_cnt(threads), heavy_cnt(threads), pending_cnt(threads);
+    std::barrier sync(threads);
+    auto total = [&](const Mem<u64>& cnt) {
+      u64 sum = 0;
+      for(u32 th = 0; th != threads; ++th) sum += cnt[th];
+      return sum;
+    };
+    // calls f on items [first, last) of the lists list(0), ..., list(threads - 1) laid end to end
+    auto for_range = [&](const Mem<u64>& cnt, u64 first, u64 last, auto&& list, auto&& f) {
+      u64 base = 0;
+      for(u32 th = 0; th != threads && base < last; base += cnt[th], ++th) {
+        const Vec<u32>& x = list(th);
+        for(u64 k = std::max(first, base), hi = std::min(last, base + cnt[th]); k < hi; ++k) f(x[k - base]);
+      }
+    };
+    auto relax = [&](Local& L, u32 u, const W2& nd) {
+      std::atomic_ref<W2> ref(dist[u]);
+      W2 old = ref.load(std::memory_order_relaxed);
+      while(nd < old) {
+        if(ref.compare_exchange_weak(old, nd, std::memory_order_relaxed)) {
+          L.bucket[bucket_id(nd) % nb].push_back(u);
+          ++L.pending;
+          break;
+        }
+      }
+    };
+    internal::ParallelFor(threads, [&](u32 th) {
+      Local& L = local[th];
+      for(u64 i = 0;; ++i) {
+        Vec<u32>& b = L.bucket[i % nb];
+        bool any = false;
+        while(true) {
+          L.cur.clear();
+          L.cur.swap(b);
+          L.pending -= L.cur.size();
+          light_cnt[th] = L.cur.size();
+          sync.arrive_and_wait();
+          const u64 cnt = total(light_cnt);
+          if(cnt == 0) break;
+          any = true;
+          for_range(light_cnt, cnt * th / threads, cnt * (th + 1) / threads, [&](u32 x) -> const Vec<u32>& { return local[x].cur; }, [&](u32 v) {
+            const W2 dv = std::atomic_ref<W2>(dist[v]).load(std::memory_order_relaxed);
+            if(bucket_id(dv) != i) return;
+            if(std::atomic_ref<u8>(settled[v]).exchange(1, std::memory_order_relaxed) == 0) L.settled.push_back(v);
+            for(u32 k = off[v]; k != light_end[v]; ++k) relax(L, to[k], dv + wt[k]);
+          });
+          sync.arrive_and_wait();
+        }
+        if(any) {
+          heavy_cnt[th] = L.settled.size();
+          sync.arrive_and_wait();
+          const u64 cnt = total(heavy_cnt);
+          for_range(heavy_cnt, cnt * th / threads, cnt * (th + 1) / threads, [&](u32 x) -> const Vec<u32>& { return local[x].settled; }, [&](u32 v) {
+            const W2 dv = dist[v];
+            for(u32 k = light_end[v]; k != off[v + 1]; ++k) relax(L, to[k], dv + wt[k]);
+          });
+          sync.arrive_and_wait();
+          L.settled.clear();
+        }
+        pending_cnt[th] = L.pending;
+        sync.arrive_and_wait();
+        if(total(pending_cnt) == 0 || (t < n && settled[t])) break;
+      }
+    });
+    // a tight edge that strictly increases the distance is a valid tree edge and cannot close a cycle
+    by_edges([&](u32, u32 first, u32 last) {
+      for(u32 v = first; v != last; ++v) {
+        if(dist[v] == inf) continue;
+        for(u32 k = off[v]; k != off[v + 1]; ++k) {
+          const u32 u = to[k];
+          if(dist[v] < dist[u] && dist[v] + wt[k] == dist[u]) std::atomic_ref<u32>(prev[u]).store(v, std::memory_order_relaxed);
+        }
+      }
+    });
+    // vertices reached only through zero-length edges hang off the tree grown so far
+    Vec<u32> queue;
+    for(u32 v = 0; v != n; ++v) {
+      if(dist[v] != inf && v != s && prev[v] == 0xffffffff) {
+        for(u32 u = 0; u != n; ++u) if(u == s || prev[u] != 0xffffffff) queue.push_back(u);
+        break;
+      }
+    }
+    for(u32 q = 0; q != queue.size(); ++q) {
+      const u32 v = queue[q];
+      for(u32 k = off[v]; k != off[v + 1]; ++k) {
+        const u32 u = to[k];
+        if(u != s && prev[u] == 0xffffffff && dist[v] + wt[k] == dist[u]) prev[u] = v, queue.push_back(u);
+      }
+    }
+    return res;
+  }
   template<class W2 = weight_type> constexpr ShortestPathResult<W2> shortest_path_bellman_ford(u32 s) const {
     const auto& g = derived();
     const u32 n = g.vertex_count();
@@ -404,6 +780,165 @@ public:
     drain_neg();
     return res;
   }
+  // visits every component in BFS order, starting from its smallest vertex
+  constexpr Vec<u32> bfs_order() const {
+    const u32 n = derived().vertex_count();
+    Vec<u32> res(n);
+    Mem<u8> visited(n, 0);
+    u32 tail = 0;
+    for(u32 s = 0; s != n; ++s) {
+      if(visited[s]) continue;
+      visited[s] = 1;
+      u32 head = tail;
+      res[tail++] = s;
+      while(head != tail) {
+        const u32 v = res[head++];
+        for(const auto& e : derived()[v]) {
+          const u32 to = e.to();
+          if(!visited[to]) visited[to] = 1, res[tail++] = to;
+        }
+      }
+    }
+    return res;
+  }
+  // by descending (out-)degree, ties by id
+  constexpr Vec<u32> degree_order() const {
+    const u32 n = derived().vertex_count();
+    Mem<u32> deg(n);
+    u32 max_deg = 0;
+    for(u32 v = 0; v != n; ++v) {
+      u32 d = 0;
+      for([[maybe_unused]] const auto& e : derived()[v]) ++d;
+      deg[v] = d;
+      if(max_deg < d) max_deg = d;
+    }
+    Mem<u32> cnt(max_deg + 2, 0);
+    for(u32 v = 0; v != n; ++v) ++cnt[max_deg - deg[v] + 1];
+    for(u32 d = 0; d <= max_deg; ++d) cnt[d + 1] += cnt[d];
+    Vec<u32> res(n);
+    for(u32 v = 0; v != n; ++v) res[cnt[max_deg - deg[v]]++] = v;
+    return res;
+  }
+  constexpr Vec<u32> reverse_cuthill_mckee_order() const {
+    const u32 n = derived().vertex_count();
+    Vec<u32> start = degree_order();
+    start.reverse();
+    Mem<u32> deg(n);
+    for(u32 v = 0; v != n; ++v) {
+      u32 d = 0;
+      for([[maybe_unused]] const auto& e : derived()[v]) ++d;
+      deg[v] = d;
+    }
+    Vec<u32> res(n);
+    Mem<u8> visited(n, 0);
+    u32 tail = 0;
+    for(const u32 s : start) {
+      if(visited[s]) continue;
+      visited[s] = 1;
+      u32 head = tail;
+      res[tail++] = s;
+      while(head != tail) {
+        const u32 v = res[head++];
+        const u32 first = tail;
+        for(const auto& e : derived()[v]) {
+          const u32 to = e.to();
+          if(!visited[to]) visited[to] = 1, res[tail++] = to;
+        }
+        std::sort(res.data() + first, res.data() + tail, [&](u32 a, u32 b) { return deg[a] != deg[b] ? deg[a] < deg[b] : a < b; });
+      }
+    }
+    res.reverse();
+    return res;
+  }
+private:
+  // pull-based power iteration on the transposed CSR; dangling mass is redistributed along restart
+  // with threads > 1 each sweep is split into ranges of vertices holding about the same number of in-arcs
+  constexpr Vec<f64> page_rank_impl(const Mem<f64>& restart, f64 damping, f64 tolerance, u32 max_iterations, u32 threads) const {
+    const u32 n = derived().vertex_count();
+    Mem<u32> off;
+    Vec<u32> to;
+    flat_adjacency(off, to);
+    Mem<u32> in_off(n + 1, 0), src(to.size()), out_deg(n);
+    for(u32 i = 0; i != to.size(); ++i) ++in_off[to[i] + 1];
+    for(u32 v = 0; v != n; ++v) in_off[v + 1] += in_off[v];
+    {
+      Mem<u32> pos = in_off;
+      for(u32 u = 0; u != n; ++u) {
+        out_deg[u] = off[u + 1] - off[u];
+        for(u32 i = off[u]; i != off[u + 1]; ++i) src[pos[to[i]]++] = u;
+      }
+    }
+    Vec<f64> x(restart.data(), restart.data() + n);
+    Mem<f64> contrib(n);
+    auto scatter = [&](u32 first, u32 last) {
+      f64 dangling = 0;
+      for(u32 u = first; u != last; ++u) {
+        if(out_deg[u] == 0) dangling += x[u], contrib[u] = 0;
+        else contrib[u] = x[u] / out_deg[u];
+      }
+      return dangling;
+    };
+    auto pull = [&](u32 first, u32 last, f64 teleport) {
+      f64 diff = 0;
+      for(u32 v = first; v != last; ++v) {
+        f64 sum = 0;
+        for(u32 i = in_off[v]; i != in_off[v + 1]; ++i) sum += contrib[src[i]];
+        const f64 y = teleport * restart[v] + damping * sum;
+        diff += y < x[v] ? x[v] - y : y - x[v];
+        x[v] = y;
+      }
+      return diff;
+    };
+    if(std::is_constant_evaluated()) threads = 1;
+    else if(threads != 1) threads = internal::ThreadsFor(static_cast<u64>(n) + to.size(), threads, 1 << 16);
+    Mem<f64> part(threads);
+    for(u32 it = 0; it != max_iterations; ++it) {
+      f64 dangling = 0, diff = 0;
+      if(threads == 1) {
+        dangling = scatter(0, n);
+        diff = pull(0, n, (1 - damping) + damping * dangling);
+      } else {
+        internal::ParallelChunks(threads, n, [&](u32 t, u64 first, u64 last) { part[t] = scatter(first, last); });
+        for(u32 t = 0; t != threads; ++t) dangling += part[t];
+        const f64 teleport = (1 - damping) + damping * dangling;
+        internal::ParallelBalancedChunks(threads, n, [&](u64 v) { return in_off[v] + v; }, [&](u32 t, u64 first, u64 last) { part[t] = pull(first, last, teleport); });
+        for(u32 t = 0; t != threads; ++t) diff += part[t];
+      }
+      if(diff < tolerance) break;
+    }
+    return x;
+  }
+public:
+  // edge weights are ignored; stops once the L1 change of a sweep drops below tolerance
+  constexpr Vec<f64> page_rank(f64 damping = 0.85, f64 tolerance = 1e-10, u32 max_iterations = 100, u32 threads = internal::DefaultThreads()) const {
+    const u32 n = derived().vertex_count();
+    if(n == 0) return {};
+    return page_rank_impl(Mem<f64>(n, 1.0 / n), damping, tolerance, max_iterations, threads);
+  }
+  // restart is normalized, so it only needs to be non-negative with a positive sum
+  constexpr Vec<f64> personalized_page_rank(const Vec<f64>& restart, f64 damping = 0.85, f64 tolerance = 1e-10, u32 max_iterations = 100, u32 threads = internal::DefaultThreads()) const {
+    const u32 n = derived().vertex_count();
+#ifndef NDEBUG
+    if(restart.size() != n) throw Exception("gsh::internal::GraphInterface::personalized_page_rank / The size of restart differs from the number of vertices. ( size=", restart.size(), ", n=", n, " )");
+#endif
+    f64 sum = 0;
+    for(u32 v = 0; v != n; ++v) sum += restart[v];
+#ifndef NDEBUG
+    if(!(sum > 0)) throw Exception("gsh::internal::GraphInterface::personalized_page_rank / The restart vector must have a positive sum.");
+#endif
+    Mem<f64> r(n);
+    for(u32 v = 0; v != n; ++v) r[v] = restart[v] / sum;
+    return page_rank_impl(r, damping, tolerance, max_iterations, threads);
+  }
+  constexpr Vec<f64> personalized_page_rank(u32 source, f64 damping = 0.85, f64 tolerance = 1e-10, u32 max_iterations = 100, u32 threads = internal::DefaultThreads()) const {
+    const u32 n = derived().vertex_count();
+#ifndef NDEBUG
+    if(source >= n) throw Exception("gsh::internal::GraphInterface::personalized_page_rank / The index is out of range. ( source=", source, ", n=", n, " )");
+#endif
+    Mem<f64> r(n, 0.0);
+    r[source] = 1;
+    return page_rank_impl(r, damping, tolerance, max_iterations, threads);
+  }
 };
 template<class D, class W> class DirectedGraphInterface : public GraphInterface<D, W> {
   constexpr D& derived() noexcept { return *static_cast<D*>(this); }
@@ -426,31 +961,58 @@ public:
     for(u32 i = 0; i != n; ++i) deg[i] = derived()[i].size();
     return deg;
   }
+public:
   constexpr bool is_dag() const { return derived().vertex_count() == 0 || !topological_sort().empty(); }
-  constexpr Vec<u32> topological_sort() const {
+  // Kahn's algorithm level by level; threads > 1 is opt-in: wide levels are then split over threads, and the order inside such a level may vary between runs
+  constexpr Vec<u32> topological_sort(u32 threads = 1) const {
     const u32 n = derived().vertex_count();
-    Vec<u32> indeg = derived().indegree();
-    Vec<u32> st;
-    st.reserve(n);
+    Mem<u32> off;
+    Vec<u32> to;
+    this->flat_adjacency(off, to);
+    Mem<u32> indeg(n, 0);
+    for(u32 i = 0; i != to.size(); ++i) ++indeg[to[i]];
+    // res doubles as the queue
+    Vec<u32> res(n);
+    u32 head = 0, tail = 0;
     for(u32 i = 0; i != n; ++i)
-      if(indeg[i] == 0) st.push_back(i);
-    Vec<u32> res;
-    res.reserve(n);
-    while(!st.empty()) {
-      const u32 v = st.back();
-      st.pop_back();
-      res.push_back(v);
-      for(const auto& e : derived()[v]) {
-        const u32 to = e.to();
-        if(--indeg[to] == 0) st.push_back(to);
+      if(indeg[i] == 0) res[tail++] = i;
+    Vec<Vec<u32>> found;
+    while(head != tail) {
+      const u32 level_end = tail;
+      const u32 th = threads == 1 ? 1 : internal::ThreadsFor(level_end - head, threads, 1 << 13);
+      if(th == 1) {
+        while(head != level_end) {
+          const u32 v = res[head++];
+          for(u32 i = off[v]; i != off[v + 1]; ++i)
+            if(--indeg[to[i]] == 0) res[tail++] = to[i];
+        }
+        continue;
+      }
+      found.resize(th);
+      internal::ParallelChunks(th, level_end - head, [&](u32 t, u64 first, u64 last) {
+        found[t].clear();
+        for(u64 k = head + first; k != head + last; ++k) {
+          const u32 v = res[k];
+          for(u32 i = off[v]; i != off[v + 1]; ++i)
+            if(std::atomic_ref<u32>(indeg[to[i]]).fetch_sub(1, std::memory_order_relaxed) == 1) found[t].push_back(to[i]);
+        }
+      });
+      head = level_end;
+      for(u32 t = 0; t != th; ++t) {
+        std::copy(found[t].begin(), found[t].end(), res.begin() + tail);
+        tail += found[t].size();
       }
     }
-    if(res.size() != n) return {};
+    if(tail != n) return {};
     return res;
   }
   template<class Comp = Less> constexpr Vec<u32> minimum_topological_sort(Comp comp = Comp()) const {
     const u32 n = derived().vertex_count();
-    Vec<u32> indeg = derived().indegree();
+    Mem<u32> off;
+    Vec<u32> to;
+    this->flat_adjacency(off, to);
+    Mem<u32> indeg(n, 0);
+    for(u32 i = 0; i != to.size(); ++i) ++indeg[to[i]];
     Heap<u32, Comp> heap(comp);
     for(u32 i = 0; i != n; ++i)
       if(indeg[i] == 0) heap.push(i);
@@ -460,91 +1022,195 @@ public:
       const u32 v = heap.min();
       heap.pop_min();
       res.push_back(v);
-      for(const auto& e : derived()[v]) {
-        const u32 to = e.to();
-        if(--indeg[to] == 0) heap.push(to);
-      }
+      for(u32 i = off[v]; i != off[v + 1]; ++i)
+        if(--indeg[to[i]] == 0) heap.push(to[i]);
     }
     if(res.size() != n) return {};
     return res;
   }
+  // Pearce's algorithm; components are numbered in topological order
   constexpr ConnectedComponents strongly_connected_components() const {
     const u32 n = derived().vertex_count();
-    const u32 m = derived().edge_count();
     if(n == 0) return {};
-    constexpr u32 npos = 0xffffffffu;
-    Mem<u32> head(n + 1), to(m), dfn(n, 0), low(n, 0), parent(n, npos), stk(n);
-    Mem<u8> in_stk(n, 0);
-    Mem<u32> comp_id(n), comp_list(n), comp_start(n), comp_size(n);
-    Mem<std::pair<u32, u32>> dfs_buf(n);
-    head[0] = std::ranges::size(derived()[0]);
-    for(u32 u = 1; u != n; ++u) head[u] = head[u - 1] + std::ranges::size(derived()[u]);
-    head[n] = head[n - 1];
-    for(u32 u = 0; u != n; ++u) {
-      for(const auto& e : derived()[u]) {
-        const u32 v = e.to();
-        to[--head[u]] = v;
-      }
-    }
-    u32 write_ptr = n;
-    u32 sp = 0;
-    u32 comp_cnt = 0;
-    std::pair<u32, u32>* dfs;
-    u32 timer = 0;
+    Mem<u32> off;
+    Vec<u32> to;
+    this->flat_adjacency(off, to);
+    // rindex[v]: 0 while unvisited, the dfs index while open, n - (completion order) once assigned
+    Mem<u32> rindex(n, 0), stk(n);
+    struct Frame {
+      u32 v, ei;
+      bool root;
+    };
+    Mem<Frame> dfs_buf(n);
+    u32 index = 1, c = n, sp = 0;
     for(u32 s = 0; s != n; ++s) {
-      if(dfn[s]) continue;
-      parent[s] = npos;
-      dfs = dfs_buf.data();
-      *(dfs++) = {s, head[s]};
-      dfn[s] = low[s] = ++timer;
-      stk[sp++] = s;
-      in_stk[s] = 1;
+      if(rindex[s]) continue;
+      Frame* dfs = dfs_buf.data();
+      *(dfs++) = {s, off[s], true};
+      rindex[s] = index++;
       while(dfs != dfs_buf.data()) {
-        u32 u = (dfs - 1)->first;
-        u32& ei = (dfs - 1)->second;
-        u32 end = head[u + 1];
-        if(ei < end) {
-          u32 v = to[ei++];
-          u32 vdfn = dfn[v];
-          if(vdfn == 0) {
-            parent[v] = u;
-            dfs->first = v;
-            dfs->second = head[v];
-            ++dfs;
-            dfn[v] = low[v] = ++timer;
-            stk[sp++] = v;
-            in_stk[v] = 1;
-          } else if(in_stk[v]) {
-            if(vdfn < low[u]) low[u] = vdfn;
-          }
+        Frame& f = *(dfs - 1);
+        const u32 u = f.v;
+        if(f.ei != off[u + 1]) {
+          const u32 v = to[f.ei++];
+          if(rindex[v] == 0) {
+            *(dfs++) = {v, off[v], true};
+            rindex[v] = index++;
+          } else if(rindex[v] < rindex[u]) rindex[u] = rindex[v], f.root = false;
           continue;
         }
+        const bool root = f.root;
         --dfs;
-        u32 p = parent[u];
-        u32 lowu = low[u];
-        if(p != npos && lowu < low[p]) low[p] = lowu;
-        if(lowu == dfn[u]) {
-          u32 sz = 0;
-          while(true) {
-            const u32 v = stk[--sp];
-            in_stk[v] = 0;
-            comp_id[v] = comp_cnt;
-            comp_list[--write_ptr] = v;
-            ++sz;
-            if(v == u) break;
+        if(root) {
+          --index;
+          while(sp != 0 && rindex[u] <= rindex[stk[sp - 1]]) {
+            rindex[stk[--sp]] = c;
+            --index;
           }
-          comp_size[comp_cnt] = sz;
-          comp_start[comp_cnt] = write_ptr;
-          ++comp_cnt;
+          rindex[u] = c--;
+        } else stk[sp++] = u;
+        if(dfs != dfs_buf.data()) {
+          Frame& p = *(dfs - 1);
+          if(rindex[u] < rindex[p.v]) rindex[p.v] = rindex[u], p.root = false;
         }
       }
     }
-    for(u32 v = 0; v != n; ++v) comp_id[v] = (comp_cnt - 1) - comp_id[v];
-    std::ranges::reverse(comp_size.data(), comp_size.data() + comp_cnt);
-    std::ranges::reverse(comp_start.data(), comp_start.data() + comp_cnt);
-    return {n, comp_cnt, std::move(comp_id), std::move(comp_start), std::move(comp_size), std::move(comp_list)};
+    const u32 comp_cnt = n - c;
+    Mem<u32> comp_start(comp_cnt), comp_size(comp_cnt, 0), comp_list(n);
+    for(u32 v = 0; v != n; ++v) ++comp_size[rindex[v] -= c + 1];
+    for(u32 i = 0, sum = 0; i != comp_cnt; ++i) comp_start[i] = sum, sum += comp_size[i];
+    Mem<u32> pos = comp_start;
+    for(u32 v = 0; v != n; ++v) comp_list[pos[rindex[v]]++] = v;
+    return {n, comp_cnt, std::move(rindex), std::move(comp_start), std::move(comp_size), std::move(comp_list)};
+  }
+  // the DAG of strongly connected components without duplicated edges
+  constexpr Condensation condensation() const {
+    ConnectedComponents scc = strongly_connected_components();
+    const u32 k = scc.size();
+    Mem<u32> off(k + 1), last(k, 0xffffffffu);
+    Vec<u32> to;
+    off[0] = 0;
+    for(u32 c = 0; c != k; ++c) {
+      for(const u32 u : scc[c]) {
+        for(const auto& e : derived()[u]) {
+          const u32 d = scc.id(e.to());
+          if(d != c && last[d] != c) last[d] = c, to.push_back(d);
+        }
+      }
+      off[c + 1] = to.size();
+    }
+    Mem<u32> flat(to.size());
+    for(u32 i = 0; i != to.size(); ++i) flat[i] = to[i];
+    return {std::move(scc), std::move(off), std::move(flat)};
+  }
+  // adjacency lists keep their iteration order
+  constexpr D relabeled(const VertexRelabeling& p) const {
+    const u32 n = derived().vertex_count();
+    D res(n);
+    res.reserve(derived().edge_count());
+    Vec<edge_type> buf;
+    for(u32 u = 0; u != n; ++u) {
+      buf.clear();
+      for(const auto& e : derived()[p.to_old(u)]) buf.push_back(e);
+      for(u32 i = buf.size(); i--;) {
+        if constexpr(is_weighted) res.connect(u, p.to_new(buf[i].to()), buf[i].weight());
+        else res.connect(u, p.to_new(buf[i].to()));
+      }
+    }
+    return res;
   }
 };
+// Hopcroft-Karp on a CSR from the left side to the right side; ml and mr must be filled with 0xffffffff or hold a valid matching
+constexpr u32 HopcroftKarp(u32 nl, const u32* off, const u32* adj, u32* ml, u32* mr) {
+  constexpr u32 npos = 0xffffffffu;
+  u32 res = 0;
+  for(u32 l = 0; l != nl; ++l) {
+    if(ml[l] != npos) {
+      ++res;
+      continue;
+    }
+    for(u32 i = off[l]; i != off[l + 1]; ++i) {
+      if(mr[adj[i]] == npos) {
+        ml[l] = adj[i], mr[adj[i]] = l, ++res;
+        break;
+      }
+    }
+  }
+  Mem<u32> dist(nl), q(nl), it(nl), stk(nl);
+  while(true) {
+    u32 head = 0, tail = 0;
+    for(u32 l = 0; l != nl; ++l) {
+      if(ml[l] == npos) dist[l] = 0, q[tail++] = l;
+      else dist[l] = npos;
+    }
+    bool found = false;
+    while(head != tail) {
+      const u32 l = q[head++];
+      for(u32 i = off[l]; i != off[l + 1]; ++i) {
+        const u32 l2 = mr[adj[i]];
+        if(l2 == npos) found = true;
+        else if(dist[l2] == npos) dist[l2] = dist[l] + 1, q[tail++] = l2;
+      }
+    }
+    if(!found) break;
+    for(u32 l = 0; l != nl; ++l) it[l] = off[l];
+    // vertex-disjoint augmenting paths along the layers; stk[k] leaves through adj[it[stk[k]]]
+    for(u32 s = 0; s != nl; ++s) {
+      if(ml[s] != npos) continue;
+      u32 sp = 0;
+      stk[sp++] = s;
+      while(sp != 0) {
+        const u32 l = stk[sp - 1];
+        if(it[l] == off[l + 1]) {
+          dist[l] = npos;
+          --sp;
+          continue;
+        }
+        const u32 l2 = mr[adj[it[l]]];
+        if(l2 == npos) {
+          for(u32 k = 0; k != sp; ++k) {
+            const u32 u = stk[k], r = adj[it[u]];
+            ml[u] = r, mr[r] = u;
+          }
+          ++res;
+          break;
+        }
+        if(dist[l2] == dist[l] + 1) stk[sp++] = l2;
+        else ++it[l];
+      }
+    }
+  }
+  return res;
+}
+// |a ∩ b| for strictly increasing arrays
+constexpr u64 SortedIntersectionCount(const u32* a, u32 na, const u32* b, u32 nb) {
+  u32 i = 0, j = 0;
+  u64 cnt = 0;
+#if defined(__AVX2__)
+  if(!std::is_constant_evaluated()) {
+    const __m256i rot = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+    while(i + 8 <= na && j + 8 <= nb) {
+      const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+      __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + j));
+      __m256i eq = _mm256_cmpeq_epi32(va, vb);
+      for(u32 k = 1; k != 8; ++k) {
+        vb = _mm256_permutevar8x32_epi32(vb, rot);
+        eq = _mm256_or_si256(eq, _mm256_cmpeq_epi32(va, vb));
+      }
+      cnt += std::popcount(static_cast<u32>(_mm256_movemask_ps(_mm256_castsi256_ps(eq))));
+      const u32 amax = a[i + 7], bmax = b[j + 7];
+      i += (amax <= bmax) * 8;
+      j += (bmax <= amax) * 8;
+    }
+  }
+#endif
+  while(i != na && j != nb) {
+    if(a[i] < b[j]) ++i;
+    else if(b[j] < a[i]) ++j;
+    else ++cnt, ++i, ++j;
+  }
+  return cnt;
+}
 template<class D, class W> class UndirectedGraphInterface : public GraphInterface<D, W> {
   constexpr D& derived() noexcept { return *static_cast<D*>(this); }
   constexpr const D& derived() const noexcept { return *static_cast<const D*>(this); }
@@ -567,14 +1233,103 @@ public:
     }
     return uf.groups();
   }
-  constexpr u32 count_connected_components() const {
+  // comp[v] is the minimum vertex in the component of v; with threads > 1 the link and compress passes run in parallel, linking by CAS
+  constexpr Mem<u32> connected_component_roots(u32 threads = internal::DefaultThreads()) const {
     const u32 n = derived().vertex_count();
-    UnionFind uf(n);
-    for(u32 i = 0; i != n; ++i) {
-      for(const auto& e : derived()[i])
-        if(i < e.to()) uf.merge(i, e.to());
+    Mem<u32> comp(n);
+    for(u32 v = 0; v != n; ++v) comp[v] = v;
+    if(std::is_constant_evaluated()) threads = 1;
+    else threads = internal::ThreadsFor(n, threads, 1 << 15);
+    const bool par = threads > 1;
+    auto load = [&](u32 v) { return par ? std::atomic_ref<u32>(comp[v]).load(std::memory_order_relaxed) : comp[v]; };
+    auto link = [&](u32 u, u32 v) {
+      u32 p1 = load(u), p2 = load(v);
+      while(p1 != p2) {
+        const u32 high = p1 < p2 ? p2 : p1;
+        const u32 low = p1 < p2 ? p1 : p2;
+        u32 p_high = load(high);
+        if(p_high == low) break;
+        if(p_high == high) {
+          if(!par) {
+            comp[high] = low;
+            break;
+          }
+          if(std::atomic_ref<u32>(comp[high]).compare_exchange_strong(p_high, low, std::memory_order_relaxed)) break;
+        }
+        p1 = load(load(high));
+        p2 = load(low);
+      }
+    };
+    auto for_vertices = [&](auto&& f) {
+      if(!par) f(0, n);
+      else internal::ParallelChunks(threads, n, [&](u32, u64 first, u64 last) { f(static_cast<u32>(first), static_cast<u32>(last)); });
+    };
+    auto compress = [&]() {
+      for_vertices([&](u32 first, u32 last) {
+        for(u32 v = first; v != last; ++v) {
+          u32 c = load(v);
+          while(c != load(c)) c = load(c);
+          if(par) std::atomic_ref<u32>(comp[v]).store(c, std::memory_order_relaxed);
+          else comp[v] = c;
+        }
+      });
+    };
+    constexpr u32 neighbor_rounds = 2;
+    for_vertices([&](u32 first, u32 last) {
+      for(u32 v = first; v != last; ++v) {
+        u32 k = 0;
+        for(const auto& e : derived()[v]) {
+          if(k++ == neighbor_rounds) break;
+          link(v, e.to());
+        }
+      }
+    });
+    compress();
+    u32 frequent = n;
+    if(n != 0) {
+      constexpr u32 sample_count = 1024;
+      Vec<u32> sample(sample_count < n ? sample_count : n);
+      for(u32 i = 0; i != sample.size(); ++i) sample[i] = comp[static_cast<u32>(static_cast<u64>(i) * n / sample.size())];
+      std::ranges::sort(sample);
+      u32 best = 0;
+      for(u32 i = 0, j = 0; i != sample.size(); i = j) {
+        while(j != sample.size() && sample[j] == sample[i]) ++j;
+        if(j - i > best) best = j - i, frequent = sample[i];
+      }
     }
-    return uf.count_groups();
+    for_vertices([&](u32 first, u32 last) {
+      for(u32 v = first; v != last; ++v) {
+        if(load(v) == frequent) continue;
+        u32 k = 0;
+        for(const auto& e : derived()[v]) {
+          if(k++ < neighbor_rounds) continue;
+          link(v, e.to());
+        }
+      }
+    });
+    compress();
+    return comp;
+  }
+  constexpr ConnectedComponents connected_component_labels() const {
+    const u32 n = derived().vertex_count();
+    if(n == 0) return {};
+    Mem<u32> comp_id = connected_component_roots();
+    u32 comp_cnt = 0;
+    for(u32 v = 0; v != n; ++v) comp_cnt += comp_id[v] == v;
+    Mem<u32> comp_start(comp_cnt), comp_size(comp_cnt, 0), comp_list(n);
+    for(u32 v = 0, c = 0; v != n; ++v) comp_id[v] = (comp_id[v] == v ? c++ : comp_id[comp_id[v]]);
+    for(u32 v = 0; v != n; ++v) ++comp_size[comp_id[v]];
+    for(u32 c = 0, sum = 0; c != comp_cnt; ++c) comp_start[c] = sum, sum += comp_size[c];
+    Mem<u32> pos = comp_start;
+    for(u32 v = 0; v != n; ++v) comp_list[pos[comp_id[v]]++] = v;
+    return {n, comp_cnt, std::move(comp_id), std::move(comp_start), std::move(comp_size), std::move(comp_list)};
+  }
+  constexpr u32 count_connected_components() const {
+    const u32 n = derived().vertex_count();
+    const Mem<u32> comp = connected_component_roots();
+    u32 cnt = 0;
+    for(u32 v = 0; v != n; ++v) cnt += comp[v] == v;
+    return cnt;
   }
   constexpr bool is_connected_graph() const { return derived().vertex_count() == 0 ? true : (count_connected_components() == 1); }
   constexpr bool is_tree() const {
@@ -598,7 +1353,8 @@ public:
     if(cnt1 != 2) return false;
     return is_connected_graph();
   }
-  template<class Comp = Less> constexpr auto minimum_spanning_forest_cost(const Comp& comp = Comp()) const {
+  // filter-Kruskal; with threads > 1 the filter of large edge ranges runs in parallel
+  template<class Comp = Less> constexpr auto minimum_spanning_forest_cost(const Comp& comp = Comp(), u32 threads = internal::DefaultThreads()) const {
     const u32 n = derived().vertex_count();
     struct E {
       weight_type w;
@@ -618,14 +1374,318 @@ public:
         }
       }
     }
-    es.sort([&](const E& a, const E& b) { return std::invoke(comp, a.w, b.w); });
-    UnionFind uf(n);
+    if(std::is_constant_evaluated()) threads = 1;
+    // union by size with path halving; the filter only reads parent, so it can walk it from several threads
+    Mem<u32> parent(n), size(n, 1);
+    for(u32 v = 0; v != n; ++v) parent[v] = v;
+    auto find = [&](u32 v) {
+      while(parent[v] != v) v = parent[v] = parent[parent[v]];
+      return v;
+    };
+    auto find_const = [&](u32 v) {
+      while(parent[v] != v) v = parent[v];
+      return v;
+    };
     weight_type res{};
-    for(const auto& e : es) {
-      if(!uf.merge_same(e.a, e.b)) res = res + e.w;
+    u32 merged = 0;
+    auto add = [&](const E& e) {
+      u32 a = find(e.a), b = find(e.b);
+      if(a == b) return;
+      if(size[a] < size[b]) std::swap(a, b);
+      parent[b] = a, size[a] += size[b];
+      res = res + e.w, ++merged;
+    };
+    // keeps the edges of [l, r) whose ends are still apart, in order, and returns the new end
+    constexpr u32 parallel_grain = 1 << 16;
+    Vec<Vec<E>> kept;
+    auto filter = [&](u32 l, u32 r) -> u32 {
+      const u32 th = threads == 1 ? 1 : internal::ThreadsFor(r - l, threads, parallel_grain);
+      if(th == 1) {
+        u32 k = l;
+        for(u32 i = l; i != r; ++i) {
+          if(find(es[i].a) != find(es[i].b)) es[k++] = es[i];
+        }
+        return k;
+      }
+      kept.resize(th);
+      internal::ParallelChunks(th, r - l, [&](u32 t, u64 first, u64 last) {
+        kept[t].clear();
+        for(u64 i = l + first; i != l + last; ++i) {
+          if(find_const(es[i].a) != find_const(es[i].b)) kept[t].push_back(es[i]);
+        }
+      });
+      u32 k = l;
+      for(u32 t = 0; t != th; ++t) {
+        std::copy(kept[t].begin(), kept[t].end(), es.begin() + k);
+        k += kept[t].size();
+      }
+      return k;
+    };
+    auto less = [&](const E& a, const E& b) { return static_cast<bool>(std::invoke(comp, a.w, b.w)); };
+    auto kruskal = [&](auto&& self, u32 l, u32 r) -> void {
+      if(merged + 1 >= n) return;
+      if(r - l <= 64) {
+        std::ranges::sort(es.begin() + l, es.begin() + r, less);
+        for(u32 i = l; i != r; ++i) add(es[i]);
+        return;
+      }
+      const E& x = es[l];
+      const E& y = es[l + (r - l) / 2];
+      const E& z = es[r - 1];
+      const weight_type pivot = less(x, y) ? (less(y, z) ? y.w : (less(x, z) ? z.w : x.w)) : (less(x, z) ? x.w : (less(y, z) ? z.w : y.w));
+      u32 mid = std::ranges::partition(es.begin() + l, es.begin() + r, [&](const E& e) { return static_cast<bool>(std::invoke(comp, e.w, pivot)); }).begin() - es.begin();
+      if(mid == l) mid = std::ranges::partition(es.begin() + l, es.begin() + r, [&](const E& e) { return !static_cast<bool>(std::invoke(comp, pivot, e.w)); }).begin() - es.begin();
+      if(mid == r) {
+        for(u32 i = l; i != r; ++i) add(es[i]);
+        return;
+      }
+      self(self, l, mid);
+      self(self, mid, filter(mid, r));
+    };
+    kruskal(kruskal, 0, es.size());
+    return res;
+  }
+private:
+  // edges oriented from lower to higher (degree, id) rank, in rank ids; lists are sorted and free of duplicates and self-loops
+  constexpr void oriented_adjacency(Mem<u32>& off, Mem<u32>& to, Mem<u32>& rank, u32 threads = 1) const {
+    const u32 n = derived().vertex_count();
+    Mem<u32> foff;
+    Vec<u32> fto;
+    this->flat_adjacency(foff, fto);
+    u32 max_deg = 0;
+    for(u32 v = 0; v != n; ++v) max_deg = std::max(max_deg, foff[v + 1] - foff[v]);
+    Mem<u32> cnt(max_deg + 2, 0);
+    for(u32 v = 0; v != n; ++v) ++cnt[foff[v + 1] - foff[v] + 1];
+    for(u32 d = 0; d <= max_deg; ++d) cnt[d + 1] += cnt[d];
+    rank = Mem<u32>(n);
+    for(u32 v = 0; v != n; ++v) rank[v] = cnt[foff[v + 1] - foff[v]]++;
+    off = Mem<u32>(n + 1, 0);
+    for(u32 u = 0; u != n; ++u) {
+      for(u32 i = foff[u]; i != foff[u + 1]; ++i)
+        if(rank[u] < rank[fto[i]]) ++off[rank[u] + 1];
+    }
+    for(u32 i = 0; i != n; ++i) off[i + 1] += off[i];
+    to = Mem<u32>(off[n]);
+    Mem<u32> pos = off;
+    for(u32 u = 0; u != n; ++u) {
+      for(u32 i = foff[u]; i != foff[u + 1]; ++i)
+        if(rank[u] < rank[fto[i]]) to[pos[rank[u]]++] = rank[fto[i]];
+    }
+    if(threads != 1) threads = internal::ThreadsFor(off[n], threads, 1 << 16);
+    if(threads == 1) {
+      u32 k = 0;
+      for(u32 r = 0; r != n; ++r) {
+        u32* first = to.data() + off[r];
+        u32* last = to.data() + off[r + 1];
+        std::sort(first, last);
+        last = std::unique(first, last);
+        off[r] = k;
+        for(u32* p = first; p != last; ++p) to[k++] = *p;
+      }
+      off[n] = k;
+      return;
+    }
+    // sort the lists in parallel, keeping their deduplicated lengths in pos, then gather them into a fresh array
+    internal::ParallelChunks(threads, n, [&](u32, u64 first, u64 last) {
+      for(u64 r = first; r != last; ++r) {
+        u32* a = to.data() + off[r];
+        u32* b = to.data() + off[r + 1];
+        std::sort(a, b);
+        pos[r] = std::unique(a, b) - a;
+      }
+    });
+    Mem<u32> noff(n + 1);
+    noff[0] = 0;
+    for(u32 r = 0; r != n; ++r) noff[r + 1] = noff[r] + pos[r];
+    Mem<u32> nto(noff[n]);
+    internal::ParallelChunks(threads, n, [&](u32, u64 first, u64 last) {
+      for(u64 r = first; r != last; ++r) std::copy(to.data() + off[r], to.data() + off[r] + pos[r], nto.data() + noff[r]);
+    });
+    off = std::move(noff);
+    to = std::move(nto);
+  }
+  // calls f(first, last) over blocks of rank ids; blocks are handed out one at a time, since the work per vertex is very uneven
+  template<class F> static void for_rank_blocks(u32 n, u32 threads, F&& f) {
+    constexpr u32 block = 256;
+    std::atomic<u32> next = 0;
+    internal::ParallelFor(threads, [&](u32 t) {
+      for(u32 r; (r = next.fetch_add(block, std::memory_order_relaxed)) < n;) f(t, r, std::min(n, r + block));
+    });
+  }
+public:
+  // simple-graph semantics: parallel edges and self-loops are ignored; with threads > 1 the orientation and the counting are split over threads
+  constexpr u64 count_triangles(u32 threads = internal::DefaultThreads()) const {
+    if(std::is_constant_evaluated()) threads = 1;
+    const u32 n = derived().vertex_count();
+    Mem<u32> off, to, rank;
+    oriented_adjacency(off, to, rank, threads);
+    auto count = [&](u32 first, u32 last) {
+      u64 res = 0;
+      for(u32 u = first; u != last; ++u) {
+        for(u32 i = off[u]; i != off[u + 1]; ++i) {
+          const u32 v = to[i];
+          res += SortedIntersectionCount(to.data() + off[u], off[u + 1] - off[u], to.data() + off[v], off[v + 1] - off[v]);
+        }
+      }
+      return res;
+    };
+    if(threads != 1) threads = internal::ThreadsFor(off[n], threads, 1 << 14);
+    if(threads == 1) return count(0, n);
+    Mem<u64> part(threads, 0);
+    for_rank_blocks(n, threads, [&](u32 t, u32 first, u32 last) { part[t] += count(first, last); });
+    u64 res = 0;
+    for(u32 t = 0; t != threads; ++t) res += part[t];
+    return res;
+  }
+  // res[v] = number of triangles containing v
+  constexpr Vec<u64> triangles_per_vertex(u32 threads = internal::DefaultThreads()) const {
+    if(std::is_constant_evaluated()) threads = 1;
+    const u32 n = derived().vertex_count();
+    Mem<u32> off, to, rank;
+    oriented_adjacency(off, to, rank, threads);
+    Mem<u64> cnt(n, 0);
+    if(threads != 1) threads = internal::ThreadsFor(off[n], threads, 1 << 14);
+    if(threads == 1) {
+      for(u32 u = 0; u != n; ++u) {
+        for(u32 i = off[u]; i != off[u + 1]; ++i) {
+          const u32 v = to[i];
+          u32 a = off[u], b = off[v];
+          while(a != off[u + 1] && b != off[v + 1]) {
+            if(to[a] < to[b]) ++a;
+            else if(to[b] < to[a]) ++b;
+            else ++cnt[u], ++cnt[v], ++cnt[to[a]], ++a, ++b;
+          }
+        }
+      }
+    } else {
+      auto add = [&](u32 v, u64 x) { std::atomic_ref<u64>(cnt[v]).fetch_add(x, std::memory_order_relaxed); };
+      for_rank_blocks(n, threads, [&](u32, u32 first, u32 last) {
+        for(u32 u = first; u != last; ++u) {
+          u64 cu = 0;
+          for(u32 i = off[u]; i != off[u + 1]; ++i) {
+            const u32 v = to[i];
+            u64 cv = 0;
+            u32 a = off[u], b = off[v];
+            while(a != off[u + 1] && b != off[v + 1]) {
+              if(to[a] < to[b]) ++a;
+              else if(to[b] < to[a]) ++b;
+              else ++cv, add(to[a], 1), ++a, ++b;
+            }
+            if(cv != 0) add(v, cv);
+            cu += cv;
+          }
+          if(cu != 0) add(u, cu);
+        }
+      });
     }
+    Vec<u64> res(n);
+    for(u32 v = 0; v != n; ++v) res[v] = cnt[rank[v]];
     return res;
   }
+  // res[v] = triangles(v) / (d(v) choose 2) over distinct neighbors, 0 when d(v) < 2
+  constexpr Vec<f64> local_clustering_coefficient(u32 threads = internal::DefaultThreads()) const {
+    if(std::is_constant_evaluated()) threads = 1;
+    const u32 n = derived().vertex_count();
+    const Vec<u64> tri = triangles_per_vertex(threads);
+    Mem<u32> off;
+    Vec<u32> to;
+    this->flat_adjacency(off, to);
+    Vec<f64> res(n);
+    auto fill = [&](u32 first, u32 last) {
+      for(u32 v = first; v != last; ++v) {
+        u32* a = to.data() + off[v];
+        u32* b = std::remove(a, to.data() + off[v + 1], v);
+        std::sort(a, b);
+        const u64 d = std::unique(a, b) - a;
+        res[v] = d < 2 ? 0.0 : static_cast<f64>(2 * tri[v]) / static_cast<f64>(d * (d - 1));
+      }
+    };
+    if(threads != 1) threads = internal::ThreadsFor(to.size(), threads, 1 << 16);
+    if(threads == 1) fill(0, n);
+    else internal::ParallelChunks(threads, n, [&](u32, u64 first, u64 last) { fill(first, last); });
+    return res;
+  }
+  // res[v] = the largest k such that v belongs to the k-core (self-loops ignored)
+  // with threads > 1 the graph is peeled one core value at a time: every vertex of degree <= k is removed in rounds split over threads
+  constexpr Vec<u32> core_number(u32 threads = internal::DefaultThreads()) const {
+    if(std::is_constant_evaluated()) threads = 1;
+    const u32 n = derived().vertex_count();
+    Mem<u32> off;
+    Vec<u32> to;
+    this->flat_adjacency(off, to);
+    Vec<u32> deg(n, 0);
+    u32 max_deg = 0;
+    for(u32 v = 0; v != n; ++v) {
+      for(u32 i = off[v]; i != off[v + 1]; ++i) deg[v] += to[i] != v;
+      if(max_deg < deg[v]) max_deg = deg[v];
+    }
+    if(threads != 1) threads = internal::ThreadsFor(to.size(), threads, 1 << 16);
+    if(threads != 1) {
+      Vec<u32> alive(n), frontier;
+      for(u32 v = 0; v != n; ++v) alive[v] = v;
+      Vec<Vec<u32>> part(threads);
+      Mem<u32> low(threads);
+      // dst = the vertices of alive satisfying pred, in order; returns their minimum degree
+      auto select = [&](auto&& pred, Vec<u32>& dst) {
+        const u32 th = internal::ThreadsFor(alive.size(), threads, 1 << 13);
+        internal::ParallelChunks(th, alive.size(), [&](u32 t, u64 first, u64 last) {
+          part[t].clear();
+          low[t] = 0xffffffff;
+          for(u64 i = first; i != last; ++i)
+            if(pred(alive[i])) part[t].push_back(alive[i]), low[t] = std::min(low[t], deg[alive[i]]);
+        });
+        u32 sz = 0, res = 0xffffffff;
+        for(u32 t = 0; t != th; ++t) sz += part[t].size(), res = std::min(res, low[t]);
+        dst.resize(sz);
+        for(u32 t = 0, i = 0; t != th; i += part[t++].size()) std::copy(part[t].begin(), part[t].end(), dst.begin() + i);
+        return res;
+      };
+      u32 k = select([](u32) { return true; }, alive);
+      while(!alive.empty()) {
+        select([&](u32 v) { return deg[v] == k; }, frontier);
+        while(!frontier.empty()) {
+          const u32 th = internal::ThreadsFor(frontier.size(), threads, 1 << 10);
+          internal::ParallelChunks(th, frontier.size(), [&](u32 t, u64 first, u64 last) {
+            part[t].clear();
+            for(u64 i = first; i != last; ++i) {
+              const u32 v = frontier[i];
+              // racing decrements may have pushed v below k
+              std::atomic_ref<u32>(deg[v]).store(k, std::memory_order_relaxed);
+              for(u32 j = off[v]; j != off[v + 1]; ++j) {
+                std::atomic_ref<u32> d(deg[to[j]]);
+                if(d.load(std::memory_order_relaxed) > k && d.fetch_sub(1, std::memory_order_relaxed) == k + 1) part[t].push_back(to[j]);
+              }
+            }
+          });
+          u32 sz = 0;
+          for(u32 t = 0; t != th; ++t) sz += part[t].size();
+          frontier.resize(sz);
+          for(u32 t = 0, i = 0; t != th; i += part[t++].size()) std::copy(part[t].begin(), part[t].end(), frontier.begin() + i);
+        }
+        k = select([&](u32 v) { return deg[v] > k; }, alive);
+      }
+      return deg;
+    }
+    Mem<u32> bin(max_deg + 2, 0), pos(n), vert(n);
+    for(u32 v = 0; v != n; ++v) ++bin[deg[v] + 1];
+    for(u32 d = 0; d <= max_deg; ++d) bin[d + 1] += bin[d];
+    for(u32 v = 0; v != n; ++v) pos[v] = bin[deg[v]]++, vert[pos[v]] = v;
+    for(u32 d = max_deg + 1; d-- > 0;) bin[d + 1] = bin[d];
+    bin[0] = 0;
+    for(u32 i = 0; i != n; ++i) {
+      const u32 v = vert[i];
+      for(u32 j = off[v]; j != off[v + 1]; ++j) {
+        const u32 u = to[j];
+        if(deg[u] <= deg[v]) continue;
+        // move u to the front of its bucket, then shrink the bucket by one
+        const u32 du = deg[u], pu = pos[u], pw = bin[du], w = vert[pw];
+        if(u != w) pos[u] = pw, vert[pu] = w, pos[w] = pu, vert[pw] = u;
+        ++bin[du];
+        --deg[u];
+      }
+    }
+    return deg;
+  }
   constexpr Vec<bool> bipartite_graph_coloring() const {
     const u32 n = derived().vertex_count();
     Vec<i8> col(n, -1);
@@ -654,6 +1714,50 @@ public:
     for(u32 i = 0; i != n; ++i) res[i] = static_cast<bool>(col[i]);
     return res;
   }
+  // res[v] = the vertex matched with v, or 0xffffffff; empty if the graph is not bipartite
+  constexpr Vec<u32> maximum_bipartite_matching() const {
+    const u32 n = derived().vertex_count();
+    const Vec<bool> col = bipartite_graph_coloring();
+    if(col.size() != n) return {};
+    Mem<u32> id(n);
+    u32 nl = 0, nr = 0;
+    for(u32 v = 0; v != n; ++v) id[v] = col[v] ? nr++ : nl++;
+    Mem<u32> off(nl + 1), left(nl), right(nr);
+    Vec<u32> adj;
+    for(u32 v = 0; v != n; ++v) {
+      if(col[v]) {
+        right[id[v]] = v;
+        continue;
+      }
+      left[id[v]] = v;
+      off[id[v]] = adj.size();
+      for(const auto& e : derived()[v]) adj.push_back(id[e.to()]);
+    }
+    off[nl] = adj.size();
+    Mem<u32> ml(nl, 0xffffffffu), mr(nr, 0xffffffffu);
+    HopcroftKarp(nl, off.data(), adj.data(), ml.data(), mr.data());
+    Vec<u32> res(n, 0xffffffffu);
+    for(u32 l = 0; l != nl; ++l) {
+      if(ml[l] != 0xffffffffu) res[left[l]] = right[ml[l]], res[right[ml[l]]] = left[l];
+    }
+    return res;
+  }
+  constexpr D relabeled(const VertexRelabeling& p) const {
+    const u32 n = derived().vertex_count();
+    D res(n);
+    res.reserve(derived().edge_count());
+    for(u32 u = 0; u != n; ++u) {
+      bool odd_loop = false;
+      for(const auto& e : derived()[p.to_old(u)]) {
+        const u32 v = p.to_new(e.to());
+        // a self-loop is stored twice in the same list
+        if(v < u || (v == u && (odd_loop = !odd_loop))) continue;
+        if constexpr(is_weighted) res.connect(u, v, e.weight());
+        else res.connect(u, v);
+      }
+    }
+    return res;
+  }
 };
 }
 template<class W = std::monostate> class DirectedGraph : public internal::CRS<W>, public internal::DirectedGraphInterface<DirectedGraph<W>, W> {
@@ -661,12 +1765,46 @@ template<class W = std::monostate> class DirectedGraph : public internal::CRS<W>
 public:
   constexpr DirectedGraph() = default;
   constexpr DirectedGraph(u32 n) : base(n) {}
+  template<std::ranges::random_access_range R1, std::ranges::random_access_range R2> constexpr DirectedGraph(u32 n, const R1& from, const R2& to) {
+#ifndef NDEBUG
+    if(std::ranges::size(from) != std::ranges::size(to)) throw Exception("gsh::DirectedGraph::DirectedGraph / The sizes of from and to differ.");
+#endif
+    auto f = std::ranges::begin(from);
+    auto t = std::ranges::begin(to);
+    base::assign_arcs(n, std::ranges::size(from), [&](u32 i) -> u32 { return f[i]; }, [&](u32 i) -> u32 { return t[i]; }, [](u32) { return W{}; });
+  }
+  template<std::ranges::random_access_range R1, std::ranges::random_access_range R2, std::ranges::random_access_range R3> constexpr DirectedGraph(u32 n, const R1& from, const R2& to, const R3& w) {
+#ifndef NDEBUG
+    if(std::ranges::size(from) != std::ranges::size(to) || std::ranges::size(from) != std::ranges::size(w)) throw Exception("gsh::DirectedGraph::DirectedGraph / The sizes of from, to and w differ.");
+#endif
+    auto f = std::ranges::begin(from);
+    auto t = std::ranges::begin(to);
+    auto x = std::ranges::begin(w);
+    base::assign_arcs(n, std::ranges::size(from), [&](u32 i) -> u32 { return f[i]; }, [&](u32 i) -> u32 { return t[i]; }, [&](u32 i) -> W { return x[i]; });
+  }
 };
 template<class W = std::monostate> class UndirectedGraph : public internal::CRS<W>, public internal::UndirectedGraphInterface<UndirectedGraph<W>, W> {
   using base = internal::CRS<W>;
 public:
   constexpr UndirectedGraph() = default;
   constexpr UndirectedGraph(u32 n) : base(n) {}
+  template<std::ranges::random_access_range R1, std::ranges::random_access_range R2> constexpr UndirectedGraph(u32 n, const R1& a, const R2& b) {
+#ifndef NDEBUG
+    if(std::ranges::size(a) != std::ranges::size(b)) throw Exception("gsh::UndirectedGraph::UndirectedGraph / The sizes of a and b differ.");
+#endif
+    auto x = std::ranges::begin(a);
+    auto y = std::ranges::begin(b);
+    base::assign_arcs(n, 2 * std::ranges::size(a), [&](u32 i) -> u32 { return i & 1 ? y[i >> 1] : x[i >> 1]; }, [&](u32 i) -> u32 { return i & 1 ? x[i >> 1] : y[i >> 1]; }, [](u32) { return W{}; });
+  }
+  template<std::ranges::random_access_range R1, std::ranges::random_access_range R2, std::ranges::random_access_range R3> constexpr UndirectedGraph(u32 n, const R1& a, const R2& b, const R3& w) {
+#ifndef NDEBUG
+    if(std::ranges::size(a) != std::ranges::size(b) || std::ranges::size(a) != std::ranges::size(w)) throw Exception("gsh::UndirectedGraph::UndirectedGraph / The sizes of a, b and w differ.");
+#endif
+    auto x = std::ranges::begin(a);
+    auto y = std::ranges::begin(b);
+    auto z = std::ranges::begin(w);
+    base::assign_arcs(n, 2 * std::ranges::size(a), [&](u32 i) -> u32 { return i & 1 ? y[i >> 1] : x[i >> 1]; }, [&](u32 i) -> u32 { return i & 1 ? x[i >> 1] : y[i >> 1]; }, [&](u32 i) -> W { return z[i >> 1]; });
+  }
   constexpr void connect(u32 a, u32 b) {
     base::connect(a, b);
     base::connect(b, a);
@@ -678,5 +1816,88 @@ public:
   constexpr u32 edge_count() const noexcept { return base::edge_count() / 2; }
   constexpr void reserve(u32 m) { base::reserve(2 * m); }
 };
+// reads m lines of "from to" (or "from to w" for weighted G) with vertex ids starting at base
+template<class G, class Reader> constexpr G ReadGraph(Reader& r, u32 n, u32 m, u32 base = 0) {
+  Mem<u32> from(m), to(m);
+  if constexpr(G::edge_type::is_weighted) {
+    using weight_type = typename G::weight_type;
+    Mem<weight_type> w(m);
+    for(u32 i = 0; i != m; ++i) {
+      from[i] = static_cast<u32>(r.template read<u32>()) - base;
+      to[i] = static_cast<u32>(r.template read<u32>()) - base;
+      w[i] = static_cast<weight_type>(r.template read<weight_type>());
+    }
+    return G(n, Subrange(from.data(), from.data() + m), Subrange(to.data(), to.data() + m), Subrange(w.data(), w.data() + m));
+  } else {
+    for(u32 i = 0; i != m; ++i) {
+      from[i] = static_cast<u32>(r.template read<u32>()) - base;
+      to[i] = static_cast<u32>(r.template read<u32>()) - base;
+    }
+    return G(n, Subrange(from.data(), from.data() + m), Subrange(to.data(), to.data() + m));
+  }
+}
+template<class T> struct PlusTimesSemiring {
+  using value_type = T;
+  constexpr static T zero() { return T(0); }
+  constexpr static T one() { return T(1); }
+  constexpr static T add(const T& a, const T& b) { return a + b; }
+  constexpr static T mul(const T& a, const T& b) { return a * b; }
+};
+template<class T> struct MinPlusSemiring {
+  using value_type = T;
+  constexpr static T zero() { return std::numeric_limits<T>::max(); }
+  constexpr static T one() { return T(0); }
+  constexpr static T add(const T& a, const T& b) { return b < a ? b : a; }
+  constexpr static T mul(const T& a, const T& b) { return a == zero() || b == zero() ? zero() : a + b; }
+};
+template<class T> struct MaxPlusSemiring {
+  using value_type = T;
+  constexpr static T zero() { return std::numeric_limits<T>::lowest(); }
+  constexpr static T one() { return T(0); }
+  constexpr static T add(const T& a, const T& b) { return a < b ? b : a; }
+  constexpr static T mul(const T& a, const T& b) { return a == zero() || b == zero() ? zero() : a + b; }
+};
+struct OrAndSemiring {
+  using value_type = bool;
+  constexpr static bool zero() { return false; }
+  constexpr static bool one() { return true; }
+  constexpr static bool add(bool a, bool b) { return a || b; }
+  constexpr static bool mul(bool a, bool b) { return a && b; }
+};
+// y[u] = add over the edges (u, v, w) of mul(w, x[v]), where unweighted edges count as one()
+// one pass over the adjacency; it streams when the arcs are stored contiguously (bulk-built, mapped or compressed graphs)
+// with threads > 1 the degrees are read first, and each thread gets a range of rows holding about the same number of edges
+template<class G, class X, class Y, class S> constexpr void SpMV(const G& g, const X& x, Y& y, S s, u32 threads = internal::DefaultThreads()) {
+  using T = typename S::value_type;
+  const u32 n = g.vertex_count();
+#ifndef NDEBUG
+  if(std::size(x) < n || std::size(y) < n) throw Exception("gsh::SpMV / The vectors are shorter than the number of vertices. ( x=", std::size(x), ", y=", std::size(y), ", n=", n, " )");
+#endif
+  auto rows = [&](u32 first, u32 last) {
+    for(u32 u = first; u != last; ++u) {
+      T acc = s.zero();
+      for(const auto& e : g[u]) {
+        if constexpr(G::edge_type::is_weighted) acc = s.add(acc, s.mul(static_cast<T>(e.weight()), static_cast<T>(x[e.to()])));
+        else acc = s.add(acc, s.mul(s.one(), static_cast<T>(x[e.to()])));
+      }
+      y[u] = acc;
+    }
+  };
+  if(std::is_constant_evaluated()) threads = 1;
+  else if(threads != 1) threads = internal::ThreadsFor(static_cast<u64>(n) + g.edge_count(), threads, 1 << 16);
+  if(threads == 1) {
+    rows(0, n);
+    return;
+  }
+  // pre[u] = u + the number of edges of the rows before u, so empty rows still weigh one
+  Mem<u64> pre(n + 1);
+  pre[0] = 0;
+  internal::ParallelChunks(threads, n, [&](u32, u64 first, u64 last) {
+    for(u64 u = first; u != last; ++u) pre[u + 1] = g[u].size() + 1;
+  });
+  for(u32 u = 0; u != n; ++u) pre[u + 1] += pre[u];
+  internal::ParallelBalancedChunks(threads, n, [&](u64 u) { return pre[u]; }, [&](u32, u64 first, u64 last) { rows(first, last); });
+}
+template<class G, class X, class Y> constexpr void SpMV(const G& g, const X& x, Y& y) { SpMV(g, x, y, PlusTimesSemiring<std::remove_cvref_t<decltype(x[0])>>()); }
 }
 namespace std::ranges { template<class W, bool IsConst> inline constexpr bool enable_borrowed_range<gsh::internal::AdjacencyList<W, IsConst>> = true; }
@@ -0,0 +1,213 @@
+#pragma once
+#include "Exception.hpp"
+#include "LazySegmentTree.hpp"
+#include "Memory.hpp"
+#include "SegmentTree.hpp"
+#include "TypeDef.hpp"
+#include <iterator>
+#include <ranges>
+#include <utility>
+namespace gsh {
+// vertices are laid out so that every heavy path and every subtree is a contiguous range of indices
+// the tree data is stored by index, so walking a path reads consecutive memory
+class HeavyLightDecomposition {
+public:
+  using size_type = u32;
+  static constexpr size_type npos = 0xffffffffu;
+private:
+  size_type n_ = 0;
+  size_type root_ = 0;
+  Mem<size_type> index_;  // vertex -> index
+  Mem<size_type> vertex_; // index -> vertex
+  Mem<size_type> parent_; // index -> index of the parent, npos for the root
+  Mem<size_type> head_;   // index -> index of the top of its heavy path
+  Mem<size_type> depth_;  // index -> depth
+  Mem<size_type> end_;    // index -> end of its subtree range
+  constexpr void build(const Mem<size_type>& par) {
+    const size_type n = n_;
+    index_ = Mem<size_type>(n);
+    vertex_ = Mem<size_type>(n);
+    parent_ = Mem<size_type>(n);
+    head_ = Mem<size_type>(n);
+    depth_ = Mem<size_type>(n);
+    end_ = Mem<size_type>(n);
+    if(n == 0) return;
+    Mem<size_type> child_start(n + 1, 0), child(n - 1);
+    for(size_type v = 0; v != n; ++v)
+      if(v != root_) ++child_start[par[v] + 1];
+    for(size_type v = 0; v != n; ++v) child_start[v + 1] += child_start[v];
+    {
+      Mem<size_type> cur = child_start;
+      for(size_type v = 0; v != n; ++v)
+        if(v != root_) child[cur[par[v]]++] = v;
+    }
+    // bfs order, then subtree sizes bottom-up
+    Mem<size_type> order(n), size(n, 1), heavy(n, npos);
+    order[0] = root_;
+    for(size_type head = 0, tail = 1; head != tail; ++head) {
+      const size_type v = order[head];
+      for(size_type i = child_start[v]; i != child_start[v + 1]; ++i) order[tail++] = child[i];
+#ifndef NDEBUG
+      if(head + 1 == tail && tail != n) throw Exception("HeavyLightDecomposition: the parent array does not form a tree rooted at ", root_);
+#endif
+    }
+    for(size_type i = n; --i != 0;) {
+      const size_type v = order[i], p = par[v];
+      size[p] += size[v];
+      if(heavy[p] == npos || size[heavy[p]] < size[v]) heavy[p] = v;
+    }
+    // preorder with the heavy child popped right after its parent
+    Mem<size_type> stk(n), head_vertex(n);
+    size_type sp = 0, k = 0;
+    stk[sp++] = root_;
+    head_vertex[root_] = root_;
+    while(sp != 0) {
+      const size_type v = stk[--sp];
+      const size_type i = k++;
+      index_[v] = i, vertex_[i] = v;
+      parent_[i] = v == root_ ? npos : index_[par[v]];
+      depth_[i] = v == root_ ? 0 : depth_[parent_[i]] + 1;
+      head_[i] = index_[head_vertex[v]];
+      end_[i] = i + size[v];
+      for(size_type j = child_start[v]; j != child_start[v + 1]; ++j) {
+        const size_type c = child[j];
+        if(c == heavy[v]) continue;
+        head_vertex[c] = c;
+        stk[sp++] = c;
+      }
+      if(heavy[v] != npos) {
+        head_vertex[heavy[v]] = head_vertex[v];
+        stk[sp++] = heavy[v];
+      }
+    }
+  }
+  template<class Spec> constexpr static auto lazy_combine(const Spec& spec, const typename Spec::value_type& a, const typename Spec::value_type& b) { return spec.extract(spec.op(spec.embed_value(a), spec.embed_value(b))); }
+public:
+  constexpr HeavyLightDecomposition() = default;
+  template<std::ranges::forward_range R> constexpr explicit HeavyLightDecomposition(R&& parent, size_type root = 0) { assign(std::forward<R>(parent), root); }
+  template<std::forward_iterator It, std::sentinel_for<It> Sent> constexpr HeavyLightDecomposition(It first, Sent last, size_type root = 0) { assign(first, last, root); }
+  template<std::ranges::forward_range R> constexpr void assign(R&& parent, size_type root = 0) { assign(std::ranges::begin(parent), std::ranges::end(parent), root); }
+  template<std::forward_iterator It, std::sentinel_for<It> Sent> constexpr void assign(It first, Sent last, size_type root = 0) {
+    const size_type n = static_cast<size_type>(std::ranges::distance(first, last));
+    Mem<size_type> par(n);
+    for(size_type i = 0; i < n; ++i, ++first) par[i] = static_cast<size_type>(*first);
+    n_ = n;
+    root_ = root;
+#ifndef NDEBUG
+    if(n_ != 0 && root_ >= n_) throw Exception("HeavyLightDecomposition: root is out of range ( root=", root_, ", n=", n_, " )");
+    for(size_type v = 0; v < n_; ++v) {
+      if(v == root_) continue;
+      if(par[v] >= n_) throw Exception("HeavyLightDecomposition: parent[", v, "] is out of range ( p=", par[v], ", n=", n_, " )");
+    }
+#endif
+    build(par);
+  }
+  constexpr size_type size() const noexcept { return n_; }
+  constexpr bool empty() const noexcept { return n_ == 0; }
+  constexpr size_type root() const noexcept { return root_; }
+  // position of v in the layout; use it to place the value of v in a segment tree
+  constexpr size_type index(size_type v) const {
+#ifndef NDEBUG
+    if(v >= n_) throw Exception("HeavyLightDecomposition::index: v is out of range ( v=", v, ", n=", n_, " )");
+#endif
+    return index_[v];
+  }
+  constexpr size_type vertex(size_type i) const {
+#ifndef NDEBUG
+    if(i >= n_) throw Exception("HeavyLightDecomposition::vertex: i is out of range ( i=", i, ", n=", n_, " )");
+#endif
+    return vertex_[i];
+  }
+  constexpr size_type parent(size_type v) const {
+    const size_type p = parent_[index(v)];
+    return p == npos ? npos : vertex_[p];
+  }
+  constexpr size_type depth(size_type v) const { return depth_[index(v)]; }
+  constexpr size_type head(size_type v) const { return vertex_[head_[index(v)]]; }
+  // [first, second) is the index range of the subtree of v
+  constexpr std::pair<size_type, size_type> subtree_range(size_type v) const {
+    const size_type i = index(v);
+    return {i, end_[i]};
+  }
+  constexpr size_type lca(size_type a, size_type b) const {
+    size_type x = index(a), y = index(b);
+    while(head_[x] != head_[y]) {
+      if(depth_[head_[x]] < depth_[head_[y]]) std::swap(x, y);
+      x = parent_[head_[x]];
+    }
+    return vertex_[x < y ? x : y];
+  }
+  constexpr size_type dist(size_type a, size_type b) const { return depth(a) + depth(b) - 2 * depth(lca(a, b)); }
+  // calls f(l, r) for O(log n) index ranges covering the path; with edge = true the lca is excluded, so each edge is represented by its child
+  template<class F> constexpr void path_ranges(size_type a, size_type b, bool edge, F&& f) const {
+    size_type x = index(a), y = index(b);
+    while(head_[x] != head_[y]) {
+      if(depth_[head_[x]] < depth_[head_[y]]) std::swap(x, y);
+      f(head_[x], x + 1);
+      x = parent_[head_[x]];
+    }
+    if(x > y) std::swap(x, y);
+    if(x + edge <= y) f(x + edge, y + 1);
+  }
+  // calls f(l, r, reversed) in the order of the path from a to b; reversed ranges are walked from r - 1 down to l
+  template<class F> constexpr void ordered_path_ranges(size_type a, size_type b, bool edge, F&& f) const {
+    size_type x = index(a), y = index(b);
+    // ranges on the side of b are collected and emitted backwards
+    size_type down[2 * 32];
+    size_type cnt = 0;
+    while(head_[x] != head_[y]) {
+      if(depth_[head_[x]] >= depth_[head_[y]]) {
+        f(head_[x], x + 1, true);
+        x = parent_[head_[x]];
+      } else {
+        down[cnt++] = head_[y], down[cnt++] = y + 1;
+        y = parent_[head_[y]];
+      }
+    }
+    if(x > y) {
+      if(y + edge <= x) f(y + edge, x + 1, true);
+    } else {
+      if(x + edge <= y) f(x + edge, y + 1, false);
+    }
+    while(cnt != 0) {
+      const size_type r = down[--cnt], l = down[--cnt];
+      f(l, r, false);
+    }
+  }
+  // the monoid must be commutative; partial products are combined with the tree's own spec
+  template<class Spec> constexpr auto path_prod(size_type a, size_type b, const SegmentTree<Spec>& seg, bool edge = false) const {
+    const Spec& spec = seg.get_spec();
+    auto res = spec.e();
+    path_ranges(a, b, edge, [&](size_type l, size_type r) { res = spec.op(res, seg.prod(l, r)); });
+    return res;
+  }
+  // any monoid; rev must hold the value of v at n - 1 - index(v)
+  template<class Spec> constexpr auto path_prod(size_type a, size_type b, const SegmentTree<Spec>& seg, const SegmentTree<Spec>& rev, bool edge = false) const {
+    const Spec& spec = seg.get_spec();
+    auto res = spec.e();
+    ordered_path_ranges(a, b, edge, [&](size_type l, size_type r, bool reversed) { res = spec.op(res, reversed ? rev.prod(n_ - r, n_ - l) : seg.prod(l, r)); });
+    return res;
+  }
+  template<class Spec, LazySegmentLayout Layout> constexpr auto path_prod(size_type a, size_type b, LazySegmentTree<Spec, Layout>& seg, bool edge = false) const {
+    const Spec& spec = seg.get_spec();
+    auto res = spec.extract(spec.e());
+    path_ranges(a, b, edge, [&](size_type l, size_type r) { res = lazy_combine(spec, res, seg.prod(l, r)); });
+    return res;
+  }
+  template<class Spec, LazySegmentLayout Layout> constexpr void path_apply(size_type a, size_type b, LazySegmentTree<Spec, Layout>& seg, const typename Spec::operator_type& f, bool edge = false) const {
+    path_ranges(a, b, edge, [&](size_type l, size_type r) { seg.apply(l, r, f); });
+  }
+  template<class Spec> constexpr auto subtree_prod(size_type v, const SegmentTree<Spec>& seg) const {
+    const auto [l, r] = subtree_range(v);
+    return seg.prod(l, r);
+  }
+  template<class Spec, LazySegmentLayout Layout> constexpr auto subtree_prod(size_type v, LazySegmentTree<Spec, Layout>& seg) const {
+    const auto [l, r] = subtree_range(v);
+    return seg.prod(l, r);
+  }
+  template<class Spec, LazySegmentLayout Layout> constexpr void subtree_apply(size_type v, LazySegmentTree<Spec, Layout>& seg, const typename Spec::operator_type& f) const {
+    const auto [l, r] = subtree_range(v);
+    seg.apply(l, r, f);
+  }
+};
+}
@@ -4,7 +4,9 @@
 #include "Functional.hpp"
 #include "Range.hpp"
 #include "TypeDef.hpp"
+#include "Util.hpp"
 #include "Vec.hpp"
+#include "internal/Parallel.hpp"
 #include "internal/UtilMacro.hpp"
 #include <bit>
 #include <concepts>
@@ -14,6 +16,7 @@
 #include <limits>
 #include <optional>
 #include <tuple>
+#include <type_traits>
 #include <utility>
 namespace gsh {
 namespace internal {
@@ -60,15 +63,33 @@ public:
 }
 template<class T, class U, class InternalT = T, class InternalU = U, class Op, class E, class Mapping, class Composition, class Id, class Extract = Identity, class EmbedValue = Identity, class EmbedOperator = Identity> constexpr auto MakeLazySegmentSpec(const Op& op = Op(), const E& e = E(), const Mapping& mapping = Mapping(), const Composition& composition = Composition(), const Id& id = Id(), const Extract& extract = Extract(), const EmbedValue& embed_value = EmbedValue(), const EmbedOperator& embed_operator = EmbedOperator()) { return internal::LazySegmentSpec<T, U, InternalT, InternalU, Op, E, Mapping, Composition, Id, Extract, EmbedValue, EmbedOperator>{op, e, mapping, composition, id, extract, embed_value, embed_operator}; }
 namespace segment_specs {
-template<class T> class RangeAddRangeMin : public decltype(MakeLazySegmentSpec<T, T>(Min, []() -> T { return std::numeric_limits<T>::max(); }, Plus, Plus, []() -> T { return static_cast<T>(0); })) {};
-template<class T> class RangeAddRangeMax : public decltype(MakeLazySegmentSpec<T, T>(Max, []() -> T { return std::numeric_limits<T>::lowest(); }, Plus, Plus, []() -> T { return static_cast<T>(0); })) {};
-template<class T> class RangeAddRangeSum : public decltype(MakeLazySegmentSpec<T, T, std::pair<T, u32>, T>([](const std::pair<T, u32>& a, const std::pair<T, u32>& b) { return std::pair<T, u32>{a.first + b.first, a.second + b.second}; }, []() -> std::pair<T, u32> { return {static_cast<T>(0), 0}; }, [](const T& f, const std::pair<T, u32>& x) { return std::pair<T, u32>{x.first + f * static_cast<T>(x.second), x.second}; }, Plus, []() -> T { return static_cast<T>(0); }, [](const std::pair<T, u32>& x) -> T { return x.first; }, [](const T& x) -> std::pair<T, u32> { return {x, 1}; }, [](const T& x) -> T { return x; })) {};
+template<class T> class RangeAddRangeMin : public decltype(MakeLazySegmentSpec<T, T>(Min, []() -> T { return std::numeric_limits<T>::max(); }, Plus, Plus, []() -> T { return static_cast<T>(0); })) {
+public:
+  constexpr static bool commutative_operators = true;
+};
+template<class T> class RangeAddRangeMax : public decltype(MakeLazySegmentSpec<T, T>(Max, []() -> T { return std::numeric_limits<T>::lowest(); }, Plus, Plus, []() -> T { return static_cast<T>(0); })) {
+public:
+  constexpr static bool commutative_operators = true;
+};
+template<class T> class RangeAddRangeSum : public decltype(MakeLazySegmentSpec<T, T, std::pair<T, u32>, T>([](const std::pair<T, u32>& a, const std::pair<T, u32>& b) { return std::pair<T, u32>{a.first + b.first, a.second + b.second}; }, []() -> std::pair<T, u32> { return {static_cast<T>(0), 0}; }, [](const T& f, const std::pair<T, u32>& x) { return std::pair<T, u32>{x.first + f * static_cast<T>(x.second), x.second}; }, Plus, []() -> T { return static_cast<T>(0); }, [](const std::pair<T, u32>& x) -> T { return x.first; }, [](const T& x) -> std::pair<T, u32> { return {x, 1}; }, [](const T& x) -> T { return x; })) {
+public:
+  constexpr static bool commutative_operators = true;
+};
 template<class T> class RangeSetRangeMin : public decltype(MakeLazySegmentSpec<T, std::optional<T>>(Min, []() -> T { return std::numeric_limits<T>::max(); }, [](const std::optional<T>& f, const T& x) { return f ? *f : x; }, [](const std::optional<T>& f, const std::optional<T>& g) { return f ? f : g; }, []() -> std::optional<T> { return std::nullopt; })) {};
 template<class T> class RangeSetRangeMax : public decltype(MakeLazySegmentSpec<T, std::optional<T>>(Max, []() -> T { return std::numeric_limits<T>::lowest(); }, [](const std::optional<T>& f, const T& x) { return f ? *f : x; }, [](const std::optional<T>& f, const std::optional<T>& g) { return f ? f : g; }, []() -> std::optional<T> { return std::nullopt; })) {};
 template<class T> class RangeSetRangeSum : public decltype(MakeLazySegmentSpec<T, T, std::pair<T, u32>, std::optional<T>>([](const std::pair<T, u32>& a, const std::pair<T, u32>& b) { return std::pair<T, u32>{a.first + b.first, a.second + b.second}; }, []() -> std::pair<T, u32> { return {static_cast<T>(0), 0}; }, [](const std::optional<T>& f, const std::pair<T, u32>& x) { return f ? std::pair<T, u32>{(*f) * static_cast<T>(x.second), x.second} : x; }, [](const std::optional<T>& f, const std::optional<T>& g) { return f ? f : g; }, []() -> std::optional<T> { return std::nullopt; }, [](const std::pair<T, u32>& x) -> T { return x.first; }, [](const T& x) -> std::pair<T, u32> { return {x, 1}; }, [](const T& x) -> std::optional<T> { return x; })) {};
-template<class T> class RangeXorRangeXor : public decltype(MakeLazySegmentSpec<T, T, std::pair<T, bool>, T>([](const std::pair<T, bool>& a, const std::pair<T, bool>& b) { return std::pair<T, bool>{a.first ^ b.first, a.second ^ b.second}; }, []() -> std::pair<T, bool> { return {static_cast<T>(0), false}; }, [](const T& f, const std::pair<T, bool>& x) { return std::pair<T, bool>{static_cast<T>(x.first ^ (x.second ? f : static_cast<T>(0))), x.second}; }, Xor, []() -> T { return static_cast<T>(0); }, [](const std::pair<T, bool>& x) -> T { return x.first; }, [](const T& x) -> std::pair<T, bool> { return {x, true}; }, [](const T& x) -> T { return x; })) {};
-template<class T> class RangeOrRangeOr : public decltype(MakeLazySegmentSpec<T, T>(Or, []() -> T { return static_cast<T>(0); }, Or, Or, []() -> T { return static_cast<T>(0); })) {};
-template<class T> class RangeAndRangeAnd : public decltype(MakeLazySegmentSpec<T, T>(And, []() -> T { return ~static_cast<T>(0); }, And, And, []() -> T { return ~static_cast<T>(0); })) {};
+template<class T> class RangeXorRangeXor : public decltype(MakeLazySegmentSpec<T, T, std::pair<T, bool>, T>([](const std::pair<T, bool>& a, const std::pair<T, bool>& b) { return std::pair<T, bool>{a.first ^ b.first, a.second ^ b.second}; }, []() -> std::pair<T, bool> { return {static_cast<T>(0), false}; }, [](const T& f, const std::pair<T, bool>& x) { return std::pair<T, bool>{static_cast<T>(x.first ^ (x.second ? f : static_cast<T>(0))), x.second}; }, Xor, []() -> T { return static_cast<T>(0); }, [](const std::pair<T, bool>& x) -> T { return x.first; }, [](const T& x) -> std::pair<T, bool> { return {x, true}; }, [](const T& x) -> T { return x; })) {
+public:
+  constexpr static bool commutative_operators = true;
+};
+template<class T> class RangeOrRangeOr : public decltype(MakeLazySegmentSpec<T, T>(Or, []() -> T { return static_cast<T>(0); }, Or, Or, []() -> T { return static_cast<T>(0); })) {
+public:
+  constexpr static bool commutative_operators = true;
+};
+template<class T> class RangeAndRangeAnd : public decltype(MakeLazySegmentSpec<T, T>(And, []() -> T { return ~static_cast<T>(0); }, And, And, []() -> T { return ~static_cast<T>(0); })) {
+public:
+  constexpr static bool commutative_operators = true;
+};
 template<class T> class RangeAffineRangeSum : public decltype(MakeLazySegmentSpec<T, std::pair<T, T>, std::pair<T, u32>, std::pair<T, T>>([](const std::pair<T, u32>& a, const std::pair<T, u32>& b) { return std::pair<T, u32>{a.first + b.first, a.second + b.second}; }, []() -> std::pair<T, u32> { return {static_cast<T>(0), 0}; }, [](const std::pair<T, T>& f, const std::pair<T, u32>& x) { return std::pair<T, u32>{f.first * x.first + f.second * static_cast<T>(x.second), x.second}; }, [](const std::pair<T, T>& f, const std::pair<T, T>& g) { return std::pair<T, T>{f.first * g.first, f.first * g.second + f.second}; }, []() -> std::pair<T, T> { return {static_cast<T>(1), static_cast<T>(0)}; }, [](const std::pair<T, u32>& x) -> T { return x.first; }, [](const T& x) -> std::pair<T, u32> { return {x, 1}; }, [](const std::pair<T, T>& x) -> std::pair<T, T> { return x; })) {};
 }
 namespace internal {
@@ -221,7 +242,25 @@ template<class T> constexpr auto MakeRangeChminChmaxAddRangeSumSpec() {
 namespace segment_specs {
 template<class T> class RangeChminChmaxAddRangeSum : public decltype(internal::MakeRangeChminChmaxAddRangeSumSpec<T>()) {};
 }
-template<class Spec> requires internal::IsLazySegmentSpecImplemented<Spec> class LazySegmentTree : public ViewInterface<LazySegmentTree<Spec>, typename Spec::value_type> {
+enum class LazySegmentLayout { Heap, Blocked };
+namespace internal {
+// two sibling nodes with their pending operators; std::pair values are stored field by field so the block has no padding
+template<class V, class Op> struct LazySegmentBlock {
+  V val[2];
+  Op lazy[2];
+  GSH_INTERNAL_INLINE constexpr const V& get(u32 i) const { return val[i]; }
+  GSH_INTERNAL_INLINE constexpr void set(u32 i, const V& x) { val[i] = x; }
+};
+template<class A, class B, class Op> struct LazySegmentBlock<std::pair<A, B>, Op> {
+  A first[2];
+  B second[2];
+  Op lazy[2];
+  GSH_INTERNAL_INLINE constexpr std::pair<A, B> get(u32 i) const { return {first[i], second[i]}; }
+  GSH_INTERNAL_INLINE constexpr void set(u32 i, const std::pair<A, B>& x) { first[i] = x.first, second[i] = x.second; }
+};
+}
+// Blocked keeps each pair of siblings together with their pending operators (see internal::LazySegmentBlock), so pushing to the children touches one block instead of a value line and an operator line
+template<class Spec, LazySegmentLayout Layout = LazySegmentLayout::Heap> requires internal::IsLazySegmentSpecImplemented<Spec> class LazySegmentTree : public ViewInterface<LazySegmentTree<Spec, Layout>, typename Spec::value_type> {
   [[no_unique_address]] Spec spec;
 public:
   using value_type = typename Spec::value_type;
@@ -231,27 +270,71 @@ public:
   using size_type = u32;
   using difference_type = i32;
 private:
+  constexpr static bool is_blocked = Layout == LazySegmentLayout::Blocked;
+  using block_type = internal::LazySegmentBlock<internal_value_type, internal_operator_type>;
   size_type n;
   size_type sz;
   size_type log;
-  Vec<internal_value_type> tree;
-  Vec<internal_operator_type> lazy;
+  [[no_unique_address]] std::conditional_t<is_blocked, std::tuple<>, Vec<internal_value_type>> tree;
+  [[no_unique_address]] std::conditional_t<is_blocked, std::tuple<>, Vec<internal_operator_type>> lazy;
+  [[no_unique_address]] std::conditional_t<is_blocked, Vec<block_type>, std::tuple<>> block;
+  // a spec declares commutative_operators = true when all its operators commute with each other, which lets apply_batch skip ordering them
+  constexpr static bool commutative_operators = requires { requires Spec::commutative_operators; };
   constexpr static bool is_beats = requires(Spec s, internal_operator_type f, internal_value_type x) {
     { s.mapping(f, x) } -> std::same_as<std::optional<internal_value_type>>;
   };
-  GSH_INTERNAL_INLINE void update(size_type k) { tree[k] = spec.op(tree[2 * k], tree[2 * k + 1]); }
+  GSH_INTERNAL_INLINE constexpr decltype(auto) val(size_type k) const {
+    if constexpr(is_blocked) return block[k >> 1].get(k & 1);
+    else return tree[k];
+  }
+  GSH_INTERNAL_INLINE constexpr void set_val(size_type k, const internal_value_type& x) {
+    if constexpr(is_blocked) block[k >> 1].set(k & 1, x);
+    else tree[k] = x;
+  }
+  GSH_INTERNAL_INLINE constexpr internal_operator_type& lz(size_type k) {
+    if constexpr(is_blocked) return block[k >> 1].lazy[k & 1];
+    else return lazy[k];
+  }
+  constexpr void release() {
+    if constexpr(is_blocked) block.clear();
+    else tree.clear(), lazy.clear();
+  }
+  constexpr void allocate(size_type new_n) {
+    n = new_n;
+    sz = n > 0 ? std::bit_ceil(n) : 0;
+    log = sz ? std::countr_zero(sz) : 0;
+    if(n == 0) {
+      release();
+      return;
+    }
+    if constexpr(is_blocked) {
+      block_type b;
+      b.set(0, spec.e()), b.set(1, spec.e());
+      b.lazy[0] = spec.id(), b.lazy[1] = spec.id();
+      block.assign(sz, b);
+    } else {
+      tree.assign(2 * sz, spec.e());
+      lazy.assign(sz, spec.id());
+    }
+  }
+  // the blocks on the path from the root to leaf p are known in advance, so their misses can overlap instead of being paid one level at a time
+  GSH_INTERNAL_INLINE constexpr void prefetch_path(size_type p) const {
+    if constexpr(is_blocked)
+      for(size_type i = 1; i <= log; ++i) Prefetch(block.data() + (p >> i));
+  }
+  GSH_INTERNAL_INLINE void update(size_type k) { set_val(k, spec.op(val(2 * k), val(2 * k + 1))); }
   GSH_INTERNAL_INLINE void all_apply(size_type k, const internal_operator_type& f) {
     if constexpr(is_beats) {
-      auto res = spec.mapping(f, tree[k]);
+      auto res = spec.mapping(f, val(k));
       if(res.has_value()) {
-        tree[k] = *res;
-        if(k < sz) lazy[k] = spec.composition(f, lazy[k]);
+        set_val(k, *res);
+        if(k < sz) lz(k) = spec.composition(f, lz(k));
       } else {
         all_apply_failed(k, f);
       }
     } else {
-      tree[k] = spec.mapping(f, tree[k]);
-      if(k < sz) lazy[k] = spec.composition(f, lazy[k]);
+      set_val(k, spec.mapping(f, val(k)));
+      if(k < sz) lz(k) = spec.composition(f, lz(k));
     }
   }
   void all_apply_failed(size_type k, const internal_operator_type& f) requires (is_beats) {
@@ -259,44 +342,69 @@ private:
     if(k >= sz) [[unlikely]]
       throw Exception("LazySegmentTree: The operation cannot be applied.");
 #endif
-    internal_operator_type composed = spec.composition(f, lazy[k]);
+    internal_operator_type composed = spec.composition(f, lz(k));
     all_apply(2 * k, composed);
     all_apply(2 * k + 1, composed);
-    lazy[k] = spec.id();
+    lz(k) = spec.id();
     update(k);
   }
   GSH_INTERNAL_INLINE void push(size_type k) {
-    all_apply(2 * k, lazy[k]);
-    all_apply(2 * k + 1, lazy[k]);
-    lazy[k] = spec.id();
+    internal_operator_type& f = lz(k);
+    all_apply(2 * k, f);
+    all_apply(2 * k + 1, f);
+    f = spec.id();
   }
-public:
-  constexpr LazySegmentTree() : n(0), sz(0), log(0) {}
-  constexpr LazySegmentTree(Spec spec) : spec(spec), n(0), sz(0), log(0) {}
-  constexpr LazySegmentTree(size_type n, Spec spec = Spec()) : spec(spec), n(n) {
-    sz = n > 0 ? std::bit_ceil(n) : 0;
-    log = sz ? std::countr_zero(sz) : 0;
-    if(n > 0) {
-      tree.assign(2 * sz, spec.e());
-      lazy.assign(sz, spec.id());
+  // the leaf next to each boundary of the ranges, tagged with the lowest level whose node on its path is split by the boundary
+  template<class R> constexpr Vec<u64> batch_boundaries(const R& ranges, [[maybe_unused]] const char* caller) const {
+    Vec<u64> res;
+    if constexpr(std::ranges::sized_range<R>) res.reserve(2 * std::ranges::size(ranges));
+    for(const auto& q : ranges) {
+      const size_type l = std::get<0>(q), r = std::get<1>(q);
+#ifndef NDEBUG
+      if(l > r || r > n) throw Exception("LazySegmentTree::", caller, ": invalid range [", l, ", ", r, ") with size ", n);
+#endif
+      if(l == r) continue;
+      res.push_back(static_cast<u64>(l + sz) << 8 | std::countr_zero(l + sz));
+      res.push_back(static_cast<u64>(r + sz - 1) << 8 | std::countr_zero(r + sz));
     }
+    return res;
   }
-  template<class InputIt> requires std::forward_iterator<InputIt> constexpr LazySegmentTree(InputIt first, InputIt last, Spec spec = Spec()) : spec(spec), n(std::ranges::distance(first, last)) {
-    sz = n > 0 ? std::bit_ceil(n) : 0;
-    log = sz ? std::countr_zero(sz) : 0;
-    if(n > 0) {
-      tree.assign(2 * sz, spec.e());
-      lazy.assign(sz, spec.id());
-      auto it = first;
-      for(size_type i = 0; i < n; ++i, ++it) tree[sz + i] = spec.embed_value(*it);
-      for(size_type i = sz - 1; i >= 1; --i) update(i);
+  // sharing only pays off once the boundaries are close enough to share the lower levels; otherwise three passes over the paths miss the cache more than one call per range
+  constexpr bool dense_batch(const Vec<u64>& boundaries) const { return static_cast<u64>(boundaries.size()) * 128 >= n; }
+  // pushes every node split by some boundary, parents first, and returns them in that order
+  // after sorting, the nodes above the lca with the previous boundary were already handled unless the previous boundary did not split them
+  constexpr Vec<size_type> push_split_nodes(Vec<u64>& boundaries) {
+    boundaries.sort();
+    Vec<size_type> res;
+    size_type last[32] = {};
+    size_type prev_x = 0, prev_t = log;
+    for(const u64 b : boundaries) {
+      const size_type x = static_cast<size_type>(b >> 8), t = static_cast<size_type>(b & 0xff);
+      const size_type top = std::min(log, std::max<size_type>(std::bit_width(x ^ prev_x), prev_t + 1) - 1);
+      for(size_type i = top; i > t; --i) {
+        const size_type k = x >> i;
+        if(last[i] != k) push(k), last[i] = k, res.push_back(k);
+      }
+      prev_x = x, prev_t = t;
     }
+    return res;
   }
-  constexpr LazySegmentTree(size_type n, const value_type& value, Spec spec = Spec()) : LazySegmentTree(n, spec) {
-    internal_value_type embedded = spec.embed_value(value);
-    for(size_type i = 0; i < n; ++i) tree[sz + i] = embedded;
-    for(size_type i = sz - 1; i >= 1; --i) update(i);
+  // the subtrees rooted at this level are disjoint, with a few of them per thread for balance
+  constexpr size_type subtree_level(u32 threads) const { return std::min<size_type>(log, std::bit_width(4 * std::max(threads, 1u) - 1)); }
+  // each thread takes a contiguous run of the subtrees rooted at level d as f(first root, last root); the nodes above are left to the caller
+  template<class F> void for_each_subtree_parallel(u32 threads, size_type d, F&& f) {
+    threads = std::max(threads, 1u);
+    const size_type roots = 1u << d;
+    internal::ParallelFor(threads, [&](u32 t) { f(roots + static_cast<size_type>(static_cast<u64>(roots) * t / threads), roots + static_cast<size_type>(static_cast<u64>(roots) * (t + 1) / threads)); });
   }
+  static u32 default_threads() { return internal::DefaultThreads(); }
+public:
+  constexpr LazySegmentTree() : n(0), sz(0), log(0) {}
+  constexpr LazySegmentTree(Spec spec) : spec(spec), n(0), sz(0), log(0) {}
+  constexpr LazySegmentTree(size_type n, Spec spec = Spec()) : spec(spec) { allocate(n); }
+  template<class InputIt> requires std::forward_iterator<InputIt> constexpr LazySegmentTree(InputIt first, InputIt last, Spec spec = Spec()) : spec(spec) { assign(first, last); }
+  template<class InputIt> requires std::forward_iterator<InputIt> LazySegmentTree(InputIt first, InputIt last, u32 threads, Spec spec = Spec()) : spec(spec) { assign(first, last, threads); }
+  constexpr LazySegmentTree(size_type n, const value_type& value, Spec spec = Spec()) : spec(spec) { assign(n, value); }
   constexpr LazySegmentTree(std::initializer_list<value_type> init, Spec spec = Spec()) : LazySegmentTree(init.begin(), init.end(), spec) {}
   constexpr LazySegmentTree& operator=(std::initializer_list<value_type> il) {
     assign(il);
@@ -306,11 +414,11 @@ public:
     n = 0;
     sz = 0;
     log = 0;
-    tree.clear();
-    lazy.clear();
+    release();
   }
   constexpr bool empty() const { return n == 0; }
   constexpr size_type size() const { return n; }
+  constexpr const Spec& get_spec() const noexcept { return spec; }
   constexpr void resize(size_type n) { resize(n, spec.extract(spec.e())); }
   constexpr void resize(size_type n, const value_type& c) {
     Vec<value_type> tmp;
@@ -320,33 +428,38 @@ public:
     assign(tmp.begin(), tmp.end());
   }
   template<class InputIt> requires std::forward_iterator<InputIt> constexpr void assign(InputIt first, InputIt last) {
-    n = std::ranges::distance(first, last);
-    sz = n > 0 ? std::bit_ceil(n) : 0;
-    log = sz ? std::countr_zero(sz) : 0;
+    allocate(std::ranges::distance(first, last));
     if(n > 0) {
-      tree.assign(2 * sz, spec.e());
-      lazy.assign(sz, spec.id());
       auto it = first;
-      for(size_type i = 0; i < n; ++i, ++it) tree[sz + i] = spec.embed_value(*it);
+      for(size_type i = 0; i < n; ++i, ++it) set_val(sz + i, spec.embed_value(*it));
       for(size_type i = sz - 1; i >= 1; --i) update(i);
-    } else {
-      tree.clear();
-      lazy.clear();
     }
   }
+  // builds the subtrees below the top levels in parallel; the leaves are filled in parallel too when InputIt is random access
+  template<class InputIt> requires std::forward_iterator<InputIt> void assign(InputIt first, InputIt last, u32 threads) {
+    allocate(std::ranges::distance(first, last));
+    if(n == 0) return;
+    if constexpr(!std::random_access_iterator<InputIt>) {
+      auto it = first;
+      for(size_type i = 0; i < n; ++i, ++it) set_val(sz + i, spec.embed_value(*it));
+    }
+    const size_type d = subtree_level(threads);
+    for_each_subtree_parallel(threads, d, [&](size_type a, size_type b) {
+      if constexpr(std::random_access_iterator<InputIt>) {
+        const size_type lo = (a << (log - d)) - sz, hi = std::min(n, (b << (log - d)) - sz);
+        for(size_type i = lo; i < hi; ++i) set_val(sz + i, spec.embed_value(first[i]));
+      }
+      for(size_type i = log; i-- > d;)
+        for(size_type k = a << (i - d); k != b << (i - d); ++k) update(k);
+    });
+    for(size_type k = (1u << d) - 1; k >= 1; --k) update(k);
+  }
   constexpr void assign(size_type n, const value_type& u) {
-    this->n = n;
-    sz = n > 0 ? std::bit_ceil(n) : 0;
-    log = sz ? std::countr_zero(sz) : 0;
+    allocate(n);
     if(n > 0) {
-      tree.assign(2 * sz, spec.e());
-      lazy.assign(sz, spec.id());
       internal_value_type embedded = spec.embed_value(u);
-      for(size_type i = 0; i < n; ++i) tree[sz + i] = embedded;
+      for(size_type i = 0; i < n; ++i) set_val(sz + i, embedded);
       for(size_type i = sz - 1; i >= 1; --i) update(i);
-    } else {
-      tree.clear();
-      lazy.clear();
     }
   }
   constexpr void assign(std::initializer_list<value_type> il) { assign(il.begin(), il.end()); }
@@ -358,14 +471,16 @@ public:
     swap(log, r.log);
     swap(tree, r.tree);
     swap(lazy, r.lazy);
+    swap(block, r.block);
   }
   constexpr void set(size_type p, const value_type& x) {
 #ifndef NDEBUG
     if(p >= n) throw Exception("LazySegmentTree::set: index ", p, " is out of range [0, ", n, ")");
 #endif
     p += sz;
+    prefetch_path(p);
     for(size_type i = log; i >= 1; --i) push(p >> i);
-    tree[p] = spec.embed_value(x);
+    set_val(p, spec.embed_value(x));
     for(size_type i = 1; i <= log; ++i) update(p >> i);
   }
   constexpr value_type get(size_type p) {
@@ -373,8 +488,9 @@ public:
     if(p >= n) throw Exception("LazySegmentTree::get: index ", p, " is out of range [0, ", n, ")");
 #endif
     p += sz;
+    prefetch_path(p);
     for(size_type i = log; i >= 1; --i) push(p >> i);
-    return spec.extract(tree[p]);
+    return spec.extract(val(p));
   }
   constexpr value_type operator[](size_type p) { return get(p); }
   constexpr value_type prod(size_type l, size_type r) {
@@ -384,25 +500,28 @@ public:
     if(l == r) return spec.extract(spec.e());
     l += sz;
     r += sz;
+    prefetch_path(l);
+    prefetch_path(r - 1);
     for(size_type i = log; i >= 1; --i) {
       if(((l >> i) << i) != l) push(l >> i);
       if(((r >> i) << i) != r) push((r - 1) >> i);
     }
     internal_value_type sml = spec.e(), smr = spec.e();
     while(l < r) {
-      if(l & 1) sml = spec.op(sml, tree[l++]);
-      if(r & 1) smr = spec.op(tree[--r], smr);
+      if(l & 1) sml = spec.op(sml, val(l++));
+      if(r & 1) smr = spec.op(val(--r), smr);
       l >>= 1;
       r >>= 1;
     }
     return spec.extract(spec.op(sml, smr));
   }
-  constexpr value_type all_prod() const { return n > 0 ? spec.extract(tree[1]) : spec.extract(spec.e()); }
+  constexpr value_type all_prod() const { return n > 0 ? spec.extract(val(1)) : spec.extract(spec.e()); }
   constexpr void apply(size_type p, const operator_type& f) {
 #ifndef NDEBUG
     if(p >= n) throw Exception("LazySegmentTree::apply: index ", p, " is out of range [0, ", n, ")");
 #endif
     p += sz;
+    prefetch_path(p);
     for(size_type i = log; i >= 1; --i) push(p >> i);
     all_apply(p, spec.embed_operator(f));
     for(size_type i = 1; i <= log; ++i) update(p >> i);
@@ -414,6 +533,8 @@ public:
     if(l == r) return;
     l += sz;
     r += sz;
+    prefetch_path(l);
+    prefetch_path(r - 1);
     for(size_type i = log; i >= 1; --i) {
       if(((l >> i) << i) != l) push(l >> i);
       if(((r >> i) << i) != r) push((r - 1) >> i);
@@ -435,6 +556,91 @@ public:
       if(((r >> i) << i) != r) update((r - 1) >> i);
     }
   }
+  // out[i] = prod(l_i, r_i) for each (l_i, r_i) in queries; nodes shared by several queries are pushed only once
+  template<std::ranges::forward_range R, class Out> constexpr void prod_batch(const R& queries, Out out) {
+    Vec<u64> boundaries = batch_boundaries(queries, "prod_batch");
+    if(!dense_batch(boundaries)) {
+      for(const auto& q : queries) *out = prod(std::get<0>(q), std::get<1>(q)), ++out;
+      return;
+    }
+    push_split_nodes(boundaries);
+    for(const auto& q : queries) {
+      size_type l = std::get<0>(q) + sz, r = std::get<1>(q) + sz;
+      internal_value_type sml = spec.e(), smr = spec.e();
+      while(l < r) {
+        if(l & 1) sml = spec.op(sml, val(l++));
+        if(r & 1) smr = spec.op(val(--r), smr);
+        l >>= 1;
+        r >>= 1;
+      }
+      *out = spec.extract(spec.op(sml, smr));
+      ++out;
+    }
+  }
+  // applies f_i to [l_i, r_i) for each (l_i, r_i, f_i) in ops in order, sharing the push and update of common ancestors; the result equals calling apply for each of them
+  template<std::ranges::forward_range R> constexpr void apply_batch(const R& ops) {
+    Vec<u64> boundaries = batch_boundaries(ops, "apply_batch");
+    if(!dense_batch(boundaries)) {
+      for(const auto& q : ops) apply(std::get<0>(q), std::get<1>(q), std::get<2>(q));
+      return;
+    }
+    if constexpr(is_beats) {
+      for(const auto& q : ops) apply(std::get<0>(q), std::get<1>(q), std::get<2>(q));
+    } else {
+      const Vec<size_type> split = push_split_nodes(boundaries);
+      // nodes holding an operator of this batch; one of them above a later range is pushed first, so that the operators keep their order
+      Vec<u64> pending(commutative_operators ? 0 : (2 * sz + 63) / 64);
+      auto mark = [&](size_type k) {
+        if constexpr(!commutative_operators) pending[k / 64] |= 1ull << (k % 64);
+      };
+      auto push_pending = [&](size_type k) {
+        if(!(pending[k / 64] >> (k % 64) & 1)) return;
+        pending[k / 64] &= ~(1ull << (k % 64));
+        push(k);
+        mark(2 * k), mark(2 * k + 1);
+      };
+      for(const auto& q : ops) {
+        size_type l = std::get<0>(q) + sz, r = std::get<1>(q) + sz;
+        if(l == r) continue;
+        if constexpr(!commutative_operators) {
+          for(size_type i = log; i >= 1; --i) {
+            if(((l >> i) << i) != l) push_pending(l >> i);
+            if(((r >> i) << i) != r) push_pending((r - 1) >> i);
+          }
+        }
+        const internal_operator_type f = spec.embed_operator(std::get<2>(q));
+        while(l < r) {
+          if(l & 1) mark(l), all_apply(l++, f);
+          if(r & 1) mark(--r), all_apply(r, f);
+          l >>= 1;
+          r >>= 1;
+        }
+      }
+      // a split node may itself have received an operator after the ranges below it, so its own pending operator is kept on top
+      for(size_type i = split.size(); i--;) {
+        const size_type k = split[i];
+        set_val(k, spec.mapping(lz(k), spec.op(val(2 * k), val(2 * k + 1))));
+      }
+    }
+  }
+  // replaces every element x_i by g(x_i), or by g(i, x_i); all pending operators are pushed to the leaves on the way, and the subtrees are handled in parallel
+  template<class G> void parallel_map_leaves(G&& g, u32 threads = default_threads()) {
+    if(n == 0) return;
+    const size_type d = subtree_level(threads);
+    for(size_type k = 1; k != (1u << d); ++k) push(k);
+    for_each_subtree_parallel(threads, d, [&](size_type a, size_type b) {
+      for(size_type i = d; i != log; ++i)
+        for(size_type k = a << (i - d); k != b << (i - d); ++k) push(k);
+      const size_type lo = (a << (log - d)) - sz, hi = std::min(n, (b << (log - d)) - sz);
+      for(size_type i = lo; i < hi; ++i) {
+        if constexpr(std::invocable<G&, size_type, const value_type&>) set_val(sz + i, spec.embed_value(std::invoke(g, i, spec.extract(val(sz + i)))));
+        else set_val(sz + i, spec.embed_value(std::invoke(g, spec.extract(val(sz + i)))));
+      }
+      for(size_type i = log; i-- > d;)
+        for(size_type k = a << (i - d); k != b << (i - d); ++k) update(k);
+    });
+    for(size_type k = (1u << d) - 1; k >= 1; --k) update(k);
+  }
   template<class F> constexpr size_type max_right(size_type l, F f) {
 #ifndef NDEBUG
     if(l > n) throw Exception("LazySegmentTree::max_right: index ", l, " is out of range [0, ", n, "]");
@@ -446,18 +652,18 @@ public:
     internal_value_type sm = spec.e();
     do {
       while(l % 2 == 0) l >>= 1;
-      if(!std::invoke(f, spec.extract(spec.op(sm, tree[l])))) {
+      if(!std::invoke(f, spec.extract(spec.op(sm, val(l))))) {
         while(l < sz) {
           push(l);
           l = (2 * l);
-          if(std::invoke(f, spec.extract(spec.op(sm, tree[l])))) {
-            sm = spec.op(sm, tree[l]);
+          if(std::invoke(f, spec.extract(spec.op(sm, val(l))))) {
+            sm = spec.op(sm, val(l));
             l++;
           }
         }
         return l - sz;
       }
-      sm = spec.op(sm, tree[l]);
+      sm = spec.op(sm, val(l));
       l++;
     } while((l & -l) != l);
     return n;
@@ -474,18 +680,18 @@ public:
     do {
       r--;
       while(r > 1 && (r % 2)) r >>= 1;
-      if(!std::invoke(f, spec.extract(spec.op(tree[r], sm)))) {
+      if(!std::invoke(f, spec.extract(spec.op(val(r), sm)))) {
         while(r < sz) {
           push(r);
           r = (2 * r + 1);
-          if(std::invoke(f, spec.extract(spec.op(tree[r], sm)))) {
-            sm = spec.op(tree[r], sm);
+          if(std::invoke(f, spec.extract(spec.op(val(r), sm)))) {
+            sm = spec.op(val(r), sm);
             r--;
           }
         }
         return r + 1 - sz;
       }
-      sm = spec.op(tree[r], sm);
+      sm = spec.op(val(r), sm);
     } while((r & -r) != r);
     return 0;
   }
@@ -3,8 +3,15 @@
 #include "Memory.hpp"
 #include "SparseTable.hpp"
 #include "TypeDef.hpp"
+#include "Util.hpp"
+#include "internal/Parallel.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <iterator>
 #include <ranges>
+#include <type_traits>
+#include <utility>
 namespace gsh {
 class LowestCommonAncestor {
 public:
@@ -19,6 +26,15 @@ private:
   Mem<size_type> child_start_;
   Mem<size_type> child_;
   SparseTable<sparse_table_specs::RangeMin<u64, 6>> rmq_;
+  // long-path decomposition: every path is stored below up to as many of its ancestors (a ladder)
+  size_type jump_height_ = 0;
+  Mem<size_type> height_;
+  Mem<size_type> ladder_;
+  Mem<size_type> ladder_pos_;
+  Mem<size_type> ladder_room_; // number of ancestors of v stored before v in its ladder
+  // jump pointers to the 2^i-th ancestors, only for vertices of height jump_height_
+  Mem<size_type> jump_start_;
+  Mem<size_type> jump_;
   constexpr void build_children() {
     if(n_ == 0) {
       child_start_.clear();
@@ -44,16 +60,61 @@ private:
       child_[cur[p]++] = v;
     }
   }
-  constexpr void build_euler_rmq() {
+  // same lists as build_children: children are counted and scattered with atomics, then every list is sorted back into increasing order
+  void build_children_parallel(u32 threads) {
+    Mem<size_type> cnt(n_ + 1, 0);
+    internal::ParallelChunks(threads, n_, [&](u32, u64 first, u64 last) {
+      for(u64 v = first; v != last; ++v)
+        if(v != root_) std::atomic_ref<size_type>(cnt[parent_[v] + 1]).fetch_add(1, std::memory_order_relaxed);
+    });
+    for(size_type i = 0; i < n_; ++i) cnt[i + 1] += cnt[i];
+    child_start_ = cnt;
+    child_ = Mem<size_type>(n_ - 1);
+    internal::ParallelChunks(threads, n_, [&](u32, u64 first, u64 last) {
+      for(u64 v = first; v != last; ++v)
+        if(v != root_) child_[std::atomic_ref<size_type>(cnt[parent_[v]]).fetch_add(1, std::memory_order_relaxed)] = v;
+    });
+    internal::ParallelChunks(threads, n_, [&](u32, u64 first, u64 last) {
+      for(u64 v = first; v != last; ++v) std::sort(child_.data() + child_start_[v], child_.data() + child_start_[v + 1]);
+    });
+  }
+  // one dfs builds the euler tour for the rmq and the ladders; the dfs stack holds the ancestors a ladder needs
+  constexpr void build_tour(u32 threads) {
     if(n_ == 0) {
       depth_.clear();
       first_.clear();
       rmq_.clear();
+      height_.clear();
+      ladder_.clear();
+      ladder_pos_.clear();
+      ladder_room_.clear();
+      jump_start_.clear();
+      jump_.clear();
       return;
     }
     depth_ = Mem<size_type>(n_, 0);
     first_ = Mem<size_type>(n_, npos);
+    height_ = Mem<size_type>(n_, 0);
+    ladder_ = Mem<size_type>(2 * n_);
+    ladder_pos_ = Mem<size_type>(n_);
+    ladder_room_ = Mem<size_type>(n_);
     Mem<u64> euler(2 * n_ - 1);
+    if(threads != 1) {
+      build_jumps(euler, build_tour_parallel(euler, threads), threads);
+      return;
+    }
+    Mem<size_type> deep(n_, npos);
+    size_type ladder_len = 0;
+    auto emit_ladder = [&](size_type top, const size_type* anc, size_type anc_len) {
+      const size_type len = height_[top] + 1;
+      const size_type ext = len < anc_len ? len : anc_len;
+      for(size_type j = 0; j != ext; ++j) ladder_[ladder_len++] = anc[anc_len - ext + j];
+      for(size_type j = 0, v = top; j != len; ++j, v = deep[v]) {
+        ladder_[ladder_len] = v;
+        ladder_pos_[v] = ladder_len++;
+        ladder_room_[v] = ext + j;
+      }
+    };
     size_type euler_len = 0;
     Mem<size_type> st(n_);
     Mem<size_type> it(n_);
@@ -77,21 +138,142 @@ private:
         first_[to] = euler_len;
         euler[euler_len++] = (static_cast<u64>(depth_[to]) << 32) | static_cast<u64>(to);
       } else {
+        // every child other than the deepest one starts a new path
+        for(size_type i = child_start_[v]; i != end; ++i)
+          if(child_[i] != deep[v]) emit_ladder(child_[i], st.data(), sp);
         --sp;
         if(sp != 0) {
           const size_type p = st[sp - 1];
           euler[euler_len++] = (static_cast<u64>(depth_[p]) << 32) | static_cast<u64>(p);
+          if(deep[p] == npos || height_[p] < height_[v] + 1) height_[p] = height_[v] + 1, deep[p] = v;
         }
       }
     }
+    emit_ladder(root_, st.data(), 0);
+    build_jumps(euler, euler_len, 1);
+  }
+  // the rmq over the euler tour and the jump pointers, once the ladders are laid out
+  constexpr void build_jumps(const Mem<u64>& euler, size_type euler_len, u32 threads) {
     rmq_.assign(euler.data(), euler.data() + euler_len);
+    jump_height_ = std::bit_width(n_);
+    jump_start_ = Mem<size_type>(n_ + 1, 0);
+    for(size_type v = 0; v != n_; ++v) jump_start_[v + 1] = jump_start_[v] + (height_[v] == jump_height_ ? std::bit_width(depth_[v]) : 0);
+    jump_ = Mem<size_type>(jump_start_[n_]);
+    auto fill = [&](size_type first, size_type last) {
+      for(size_type v = first; v != last; ++v) {
+        for(size_type i = jump_start_[v]; i != jump_start_[v + 1]; ++i) jump_[i] = climb(v, 1u << (i - jump_start_[v]));
+      }
+    };
+    if(threads == 1) fill(0, n_);
+    else internal::ParallelChunks(threads, n_, [&](u32, u64 first, u64 last) { fill(first, last); });
+  }
+  // the same tour and ladders as the dfs of build_tour, computed level by level from a bfs order:
+  // subtree sizes and heights bottom-up, tour positions top-down, then every ladder is written on its own; returns the tour length
+  size_type build_tour_parallel(Mem<u64>& euler, u32 threads) {
+    Mem<size_type> order(n_), part(threads + 1);
+    Vec<size_type> level{0, 1};
+    order[0] = root_;
+    auto chunks = [&](size_type first, size_type last, auto&& f) {
+      const u32 th = internal::ThreadsFor(last - first, threads, 1 << 12);
+      internal::ParallelChunks(th, last - first, [&](u32 t, u64 l, u64 r) { f(t, first + static_cast<size_type>(l), first + static_cast<size_type>(r)); });
+      return th;
+    };
+    // each thread appends the children of its part of the level at the offset given by the counts of the parts before it
+    while(level[level.size() - 2] != level.back()) {
+      const size_type first = level[level.size() - 2], last = level.back();
+      const u32 th = chunks(first, last, [&](u32 t, size_type l, size_type r) {
+        size_type c = 0;
+        for(size_type i = l; i != r; ++i) c += child_start_[order[i] + 1] - child_start_[order[i]];
+        part[t + 1] = c;
+      });
+      part[0] = last;
+      for(u32 t = 0; t != th; ++t) part[t + 1] += part[t];
+      chunks(first, last, [&](u32 t, size_type l, size_type r) {
+        size_type k = part[t];
+        for(size_type i = l; i != r; ++i) {
+          const size_type v = order[i];
+          for(size_type j = child_start_[v]; j != child_start_[v + 1]; ++j) order[k++] = child_[j], depth_[child_[j]] = depth_[v] + 1;
+        }
+      });
+      level.push_back(part[th]);
+    }
+    Mem<size_type> sub(n_), deep(n_, npos);
+    for(size_type d = level.size() - 1; d-- > 0;) {
+      chunks(level[d], level[d + 1], [&](u32, size_type l, size_type r) {
+        for(size_type i = l; i != r; ++i) {
+          const size_type v = order[i];
+          size_type s = 1;
+          for(size_type j = child_start_[v]; j != child_start_[v + 1]; ++j) {
+            const size_type c = child_[j];
+            s += sub[c];
+            if(deep[v] == npos || height_[v] < height_[c] + 1) height_[v] = height_[c] + 1, deep[v] = c;
+          }
+          sub[v] = s;
+        }
+      });
+    }
+    first_[root_] = 0;
+    for(size_type d = 0; d + 1 != level.size(); ++d) {
+      chunks(level[d], level[d + 1], [&](u32, size_type l, size_type r) {
+        for(size_type i = l; i != r; ++i) {
+          const size_type v = order[i];
+          const u64 key = (static_cast<u64>(depth_[v]) << 32) | static_cast<u64>(v);
+          size_type pos = first_[v] + 1;
+          euler[first_[v]] = key;
+          for(size_type j = child_start_[v]; j != child_start_[v + 1]; ++j) {
+            const size_type c = child_[j];
+            first_[c] = pos;
+            pos += 2 * sub[c];
+            euler[pos - 1] = key;
+          }
+        }
+      });
+    }
+    // a ladder starts at the root and at every child other than the deepest one, and takes as many ancestors as it has vertices
+    auto top = [&](size_type v) { return v == root_ || deep[parent_[v]] != v; };
+    auto room = [&](size_type v) { return std::min(height_[v] + 1, depth_[v]); };
+    Mem<size_type> at(n_ + 1);
+    const size_type reached = level.back();
+    const u32 th = chunks(0, reached, [&](u32 t, size_type l, size_type r) {
+      size_type c = 0;
+      for(size_type i = l; i != r; ++i)
+        if(top(order[i])) c += room(order[i]) + height_[order[i]] + 1;
+      part[t + 1] = c;
+    });
+    part[0] = 0;
+    for(u32 t = 0; t != th; ++t) part[t + 1] += part[t];
+    chunks(0, reached, [&](u32 t, size_type l, size_type r) {
+      size_type k = part[t];
+      for(size_type i = l; i != r; ++i) {
+        const size_type v = order[i];
+        if(!top(v)) continue;
+        const size_type ext = room(v), len = height_[v] + 1;
+        for(size_type j = ext, u = v; j-- > 0;) u = parent_[u], ladder_[k + j] = u;
+        k += ext;
+        for(size_type j = 0, u = v; j != len; ++j, u = deep[u]) {
+          ladder_[k] = u;
+          ladder_pos_[u] = k++;
+          ladder_room_[u] = ext + j;
+        }
+      }
+    });
+    return 2 * reached - 1;
+  }
+  // the height at least doubles on every hop
+  constexpr size_type climb(size_type v, size_type k) const {
+    while(k > ladder_room_[v]) {
+      k -= ladder_room_[v];
+      v = ladder_[ladder_pos_[v] - ladder_room_[v]];
+    }
+    return ladder_[ladder_pos_[v] - k];
   }
 public:
   constexpr LowestCommonAncestor() = default;
-  template<std::ranges::forward_range R> constexpr explicit LowestCommonAncestor(R&& parent, size_type root = 0) { assign(std::forward<R>(parent), root); }
-  template<std::forward_iterator It, std::sentinel_for<It> Sent> constexpr LowestCommonAncestor(It first, Sent last, size_type root = 0) { assign(first, last, root); }
-  template<std::ranges::forward_range R> constexpr void assign(R&& parent, size_type root = 0) { assign(std::ranges::begin(parent), std::ranges::end(parent), root); }
-  template<std::forward_iterator It, std::sentinel_for<It> Sent> constexpr void assign(It first, Sent last, size_type root = 0) {
+  // with threads > 1 the tree is built level by level over threads; the queries answer the same either way
+  template<std::ranges::forward_range R> constexpr explicit LowestCommonAncestor(R&& parent, size_type root = 0, u32 threads = internal::DefaultThreads()) { assign(std::forward<R>(parent), root, threads); }
+  template<std::forward_iterator It, std::sentinel_for<It> Sent> constexpr LowestCommonAncestor(It first, Sent last, size_type root = 0, u32 threads = internal::DefaultThreads()) { assign(first, last, root, threads); }
+  template<std::ranges::forward_range R> constexpr void assign(R&& parent, size_type root = 0, u32 threads = internal::DefaultThreads()) { assign(std::ranges::begin(parent), std::ranges::end(parent), root, threads); }
+  template<std::forward_iterator It, std::sentinel_for<It> Sent> constexpr void assign(It first, Sent last, size_type root = 0, u32 threads = internal::DefaultThreads()) {
     const size_type n = static_cast<size_type>(std::ranges::distance(first, last));
     parent_ = Mem<size_type>(n);
     for(size_type i = 0; i < n; ++i, ++first) parent_[i] = static_cast<size_type>(*first);
@@ -106,8 +288,11 @@ public:
       if(p >= n_) throw Exception("LowestCommonAncestor: parent[", v, "] is out of range ( p=", p, ", n=", n_, " )");
     }
 #endif
-    build_children();
-    build_euler_rmq();
+    if(std::is_constant_evaluated()) threads = 1;
+    else if(threads != 1) threads = internal::ThreadsFor(n_, threads, 1 << 16);
+    if(threads == 1) build_children();
+    else build_children_parallel(threads);
+    build_tour(threads);
   }
   constexpr void clear() {
     n_ = 0;
@@ -118,6 +303,13 @@ public:
     child_start_.clear();
     child_.clear();
     rmq_.clear();
+    jump_height_ = 0;
+    height_.clear();
+    ladder_.clear();
+    ladder_pos_.clear();
+    ladder_room_.clear();
+    jump_start_.clear();
+    jump_.clear();
   }
   constexpr size_type size() const noexcept { return n_; }
   constexpr bool empty() const noexcept { return n_ == 0; }
@@ -148,6 +340,61 @@ public:
     }
     return static_cast<size_type>(rmq_.prod(l, r + 1));
   }
+  // out[i] = lca(queries[i]); consecutive queries are pipelined so that their cache misses overlap
+  template<std::ranges::random_access_range R, std::random_access_iterator Out> constexpr void lca_many(const R& queries, Out out) const {
+    const size_type q = std::ranges::size(queries);
+    const auto it = std::ranges::begin(queries);
+    constexpr size_type lag = 16;
+    size_type ls[lag], rs[lag];
+    for(size_type i = 0; i < q + 2 * lag; ++i) {
+      if(i >= 2 * lag) {
+        const size_type j = i - 2 * lag;
+        out[j] = static_cast<size_type>(rmq_.prod(ls[j % lag], rs[j % lag]));
+      }
+      if(i >= lag && i - lag < q) {
+        const size_type j = i - lag;
+        const auto& [a, b] = it[j];
+        size_type l = first_[a], r = first_[b];
+        if(l > r) std::swap(l, r);
+        ls[j % lag] = l, rs[j % lag] = r + 1;
+        rmq_.prefetch(l, r + 1);
+      }
+      if(i < q) {
+        const auto& [a, b] = it[i];
+#ifndef NDEBUG
+        if(static_cast<size_type>(a) >= n_ || static_cast<size_type>(b) >= n_) throw Exception("LowestCommonAncestor::lca_many: vertex is out of range ( a=", a, ", b=", b, ", n=", n_, " )");
+#endif
+        Prefetch(first_.data() + a);
+        Prefetch(first_.data() + b);
+      }
+    }
+  }
+  // the ancestor k levels above v, or npos if k > depth(v); O(1) when height(v) >= log n, O(log log n) ladder hops otherwise
+  constexpr size_type kth_ancestor(size_type v, size_type k) const {
+#ifndef NDEBUG
+    if(v >= n_) throw Exception("LowestCommonAncestor::kth_ancestor: v is out of range ( v=", v, ", n=", n_, " )");
+#endif
+    if(k > depth_[v]) return npos;
+    while(height_[v] < jump_height_) {
+      if(k <= ladder_room_[v]) return ladder_[ladder_pos_[v] - k];
+      k -= ladder_room_[v];
+      v = ladder_[ladder_pos_[v] - ladder_room_[v]];
+    }
+    if(k <= ladder_room_[v]) return ladder_[ladder_pos_[v] - k];
+    // jump from the descendant of height jump_height_ on the long path of v, then finish on a ladder
+    const size_type w = ladder_[ladder_pos_[v] + height_[v] - jump_height_];
+    k += height_[v] - jump_height_;
+    const size_type b = std::bit_width(k) - 1;
+    const size_type u = jump_[jump_start_[w] + b];
+    return ladder_[ladder_pos_[u] - (k - (1u << b))];
+  }
+  // the ancestor of v at depth d, or npos if d > depth(v)
+  constexpr size_type level_ancestor(size_type v, size_type d) const {
+#ifndef NDEBUG
+    if(v >= n_) throw Exception("LowestCommonAncestor::level_ancestor: v is out of range ( v=", v, ", n=", n_, " )");
+#endif
+    return d > depth_[v] ? npos : kth_ancestor(v, depth_[v] - d);
+  }
   constexpr size_type dist(size_type a, size_type b) const {
     const size_type c = lca(a, b);
     return depth_[a] + depth_[b] - 2 * depth_[c];
@@ -0,0 +1,247 @@
+#pragma once
+#include "Exception.hpp"
+#include "Graph.hpp"
+#include "TypeDef.hpp"
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#if defined(__linux__)
+#include <fcntl.h>    // open
+#include <sys/mman.h> // mmap
+#include <sys/stat.h> // fstat
+#include <unistd.h>   // close, write
+#endif
+namespace gsh {
+namespace internal {
+// file layout: header, u64 offsets[n + 1], u32 targets[m], padding to 8 bytes, W weights[m]
+struct MappedGraphHeader {
+  u64 magic;
+  u32 version;
+  u32 undirected;
+  u32 weight_size;
+  u32 n;
+  u64 m;
+};
+inline constexpr u64 mapped_graph_magic = 0x48505247'48534721ull;
+template<class W> class MappedAdjacencyList : public ViewInterface<MappedAdjacencyList<W>, Edge<W>> {
+  template<class W2> friend class MappedCRS;
+  constexpr static bool is_weighted = Edge<W>::is_weighted;
+  const u32* to;
+  const W* w;
+  u64 len;
+  constexpr MappedAdjacencyList(const u32* t, const W* x, u64 l) : to(t), w(x), len(l) {}
+  class iterator_impl {
+    friend class MappedAdjacencyList;
+    const u32* to = nullptr;
+    const W* w = nullptr;
+    constexpr iterator_impl(const u32* t, const W* x) : to(t), w(x) {}
+  public:
+    using difference_type = i64;
+    using value_type = Edge<W>;
+    using reference = Edge<W>;
+    using iterator_category = std::forward_iterator_tag;
+    constexpr iterator_impl() {}
+    constexpr Edge<W> operator*() const noexcept {
+      if constexpr(is_weighted) return Edge<W>(*to, *w);
+      else return Edge<W>(*to);
+    }
+    constexpr iterator_impl& operator++() noexcept {
+      ++to;
+      if constexpr(is_weighted) ++w;
+      return *this;
+    }
+    constexpr iterator_impl operator++(int) noexcept {
+      auto copy = *this;
+      operator++();
+      return copy;
+    }
+    friend constexpr bool operator==(const iterator_impl& a, const iterator_impl& b) noexcept { return a.to == b.to; }
+  };
+public:
+  using iterator = iterator_impl;
+  using const_iterator = iterator_impl;
+  constexpr u32 size() const noexcept { return len; }
+  constexpr bool empty() const noexcept { return len == 0; }
+  constexpr iterator begin() const noexcept { return iterator(to, w); }
+  constexpr iterator end() const noexcept { return iterator(to + len, w + (is_weighted ? len : 0)); }
+};
+template<class W> class MappedCRS {
+  constexpr static bool is_weighted = Edge<W>::is_weighted;
+  i32 fd = -1;
+  void* addr = nullptr;
+  u64 bytes = 0;
+  u32 n = 0;
+  u64 m = 0;
+  const u64* off = nullptr;
+  const u32* to = nullptr;
+  const W* w = nullptr;
+  void release() {
+#if defined(__linux__)
+    if(addr != nullptr) munmap(addr, bytes);
+    if(fd != -1) close(fd);
+#endif
+    fd = -1, addr = nullptr, bytes = 0, n = 0, m = 0;
+    off = nullptr, to = nullptr, w = nullptr;
+  }
+protected:
+  // the offsets are always checked, which is O(n); the O(m) target check runs when verify is set, and always in debug builds
+  void map(const c8* path, bool undirected, bool verify) {
+    release();
+#if defined(__linux__)
+    fd = ::open(path, O_RDONLY);
+    if(fd == -1) throw Exception("gsh::internal::MappedCRS::map / Failed to open the file. ( path=", path, " )");
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+      release();
+      throw Exception("gsh::internal::MappedCRS::map / fstat failed. ( path=", path, " )");
+    }
+    bytes = st.st_size;
+    if(bytes < sizeof(MappedGraphHeader)) {
+      release();
+      throw Exception("gsh::internal::MappedCRS::map / The file is too small. ( path=", path, " )");
+    }
+    addr = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    if(addr == MAP_FAILED) {
+      addr = nullptr;
+      release();
+      throw Exception("gsh::internal::MappedCRS::map / mmap failed. ( path=", path, " )");
+    }
+    MappedGraphHeader h;
+    std::memcpy(&h, addr, sizeof(h));
+    // h.m comes from the file, so it is bounded by the file size before any size is computed from it
+    const bool fits = h.m <= bytes / 4 && h.m <= bytes / sizeof(W);
+    const u64 to_end = fits ? sizeof(h) + 8 * (static_cast<u64>(h.n) + 1) + 4 * h.m : 0;
+    const u64 w_begin = (to_end + 7) / 8 * 8;
+    const u64 expected = is_weighted ? w_begin + sizeof(W) * h.m : to_end;
+    if(h.magic != mapped_graph_magic || h.version != 1 || h.undirected != static_cast<u32>(undirected) || h.weight_size != (is_weighted ? sizeof(W) : 0) || !fits || bytes < expected) {
+      release();
+      throw Exception("gsh::internal::MappedCRS::map / The file does not hold a graph of this type. ( path=", path, " )");
+    }
+    const c8* p = static_cast<const c8*>(addr);
+    const u64* o = reinterpret_cast<const u64*>(p + sizeof(h));
+    const u32* t = reinterpret_cast<const u32*>(p + sizeof(h) + 8 * (static_cast<u64>(h.n) + 1));
+    bool valid = o[0] == 0 && o[h.n] == h.m;
+    for(u32 v = 0; valid && v != h.n; ++v) valid = o[v] <= o[v + 1];
+#ifndef NDEBUG
+    verify = true;
+#endif
+    for(u64 i = 0; valid && verify && i != h.m; ++i) valid = t[i] < h.n;
+    if(!valid) {
+      release();
+      throw Exception("gsh::internal::MappedCRS::map / The adjacency data is corrupted. ( path=", path, " )");
+    }
+    n = h.n, m = h.m;
+    off = o, to = t;
+    if constexpr(is_weighted) w = reinterpret_cast<const W*>(p + w_begin);
+#else
+    (void) path, (void) undirected, (void) verify;
+    throw Exception("gsh::internal::MappedCRS::map / Memory-mapped graphs are only available on Linux.");
+#endif
+  }
+public:
+  MappedCRS() = default;
+  MappedCRS(const MappedCRS&) = delete;
+  MappedCRS(MappedCRS&& x) noexcept : fd(x.fd), addr(x.addr), bytes(x.bytes), n(x.n), m(x.m), off(x.off), to(x.to), w(x.w) { x.fd = -1, x.addr = nullptr, x.bytes = 0; }
+  MappedCRS& operator=(const MappedCRS&) = delete;
+  MappedCRS& operator=(MappedCRS&& x) noexcept {
+    if(this != &x) {
+      release();
+      fd = x.fd, addr = x.addr, bytes = x.bytes, n = x.n, m = x.m, off = x.off, to = x.to, w = x.w;
+      x.fd = -1, x.addr = nullptr, x.bytes = 0;
+    }
+    return *this;
+  }
+  ~MappedCRS() { release(); }
+  constexpr u32 vertex_count() const noexcept { return n; }
+  constexpr u64 edge_count() const noexcept { return m; }
+  constexpr MappedAdjacencyList<W> operator[](u32 v) const {
+#ifndef NDEBUG
+    if(v >= vertex_count()) [[unlikely]]
+      throw Exception("gsh::internal::MappedCRS::operator[] / The index is out of range. ( v=", v, ", size=", vertex_count(), " )");
+#endif
+    return MappedAdjacencyList<W>(to + off[v], w + (is_weighted ? off[v] : 0), off[v + 1] - off[v]);
+  }
+};
+template<class G> void SaveGraphImpl(const G& g, const c8* path, bool undirected) {
+#if defined(__linux__)
+  using W = std::remove_cvref_t<decltype(std::declval<typename G::edge_type>().weight())>;
+  constexpr bool is_weighted = G::edge_type::is_weighted;
+  const u32 n = g.vertex_count();
+  const i32 fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(fd == -1) throw Exception("gsh::SaveGraph / Failed to open the file. ( path=", path, " )");
+  constexpr u32 chunk = 1u << 16;
+  c8 buf[chunk];
+  u32 len = 0;
+  u64 written = 0;
+  auto flush = [&]() {
+    for(u32 done = 0; done != len;) {
+      const auto r = ::write(fd, buf + done, len - done);
+      if(r <= 0) {
+        close(fd);
+        throw Exception("gsh::SaveGraph / Failed to write the file. ( path=", path, " )");
+      }
+      done += r;
+    }
+    written += len;
+    len = 0;
+  };
+  auto put = [&](const void* p, u32 sz) {
+    if(len + sz > chunk) flush();
+    std::memcpy(buf + len, p, sz);
+    len += sz;
+  };
+  u64 m = 0;
+  for(u32 v = 0; v != n; ++v) {
+    for([[maybe_unused]] const auto& e : g[v]) ++m;
+  }
+  const MappedGraphHeader h{mapped_graph_magic, 1, static_cast<u32>(undirected), is_weighted ? static_cast<u32>(sizeof(W)) : 0, n, m};
+  put(&h, sizeof(h));
+  u64 cur = 0;
+  put(&cur, 8);
+  for(u32 v = 0; v != n; ++v) {
+    for([[maybe_unused]] const auto& e : g[v]) ++cur;
+    put(&cur, 8);
+  }
+  for(u32 v = 0; v != n; ++v) {
+    for(const auto& e : g[v]) {
+      const u32 t = e.to();
+      put(&t, 4);
+    }
+  }
+  if constexpr(is_weighted) {
+    const u64 zero = 0;
+    put(&zero, (8 - (written + len) % 8) % 8);
+    for(u32 v = 0; v != n; ++v) {
+      for(const auto& e : g[v]) put(&e.weight(), sizeof(W));
+    }
+  }
+  flush();
+  close(fd);
+#else
+  (void) g, (void) path, (void) undirected;
+  throw Exception("gsh::SaveGraph / Memory-mapped graphs are only available on Linux.");
+#endif
+}
+}
+// W must be trivially copyable; the file keeps the adjacency iteration order of the saved graph
+// open(path, true) also checks that every target is a vertex, for files that may have been damaged or edited by hand
+template<class W = std::monostate> class MappedDirectedGraph : public internal::MappedCRS<W>, public internal::DirectedGraphInterface<MappedDirectedGraph<W>, W> {
+  using base = internal::MappedCRS<W>;
+public:
+  MappedDirectedGraph() = default;
+  explicit MappedDirectedGraph(const c8* path, bool verify = false) { open(path, verify); }
+  void open(const c8* path, bool verify = false) { base::map(path, false, verify); }
+};
+template<class W = std::monostate> class MappedUndirectedGraph : public internal::MappedCRS<W>, public internal::UndirectedGraphInterface<MappedUndirectedGraph<W>, W> {
+  using base = internal::MappedCRS<W>;
+public:
+  MappedUndirectedGraph() = default;
+  explicit MappedUndirectedGraph(const c8* path, bool verify = false) { open(path, verify); }
+  void open(const c8* path, bool verify = false) { base::map(path, true, verify); }
+  constexpr u64 edge_count() const noexcept { return base::edge_count() / 2; }
+};
+template<class W> void SaveGraph(const DirectedGraph<W>& g, const c8* path) { internal::SaveGraphImpl(g, path, false); }
+template<class W> void SaveGraph(const UndirectedGraph<W>& g, const c8* path) { internal::SaveGraphImpl(g, path, true); }
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include "Exception.hpp"
+#include "Graph.hpp"
+#include "Memory.hpp"
+#include "TypeDef.hpp"
+#include "Vec.hpp"
+#include <iterator>
+#include <limits>
+#include <type_traits>
+#include <utility>
+namespace gsh {
+// maximum matching between left vertices [0, left) and right vertices [0, right)
+class BipartiteMatching {
+  static constexpr u32 npos = 0xffffffffu;
+  u32 nl_ = 0, nr_ = 0, size_ = 0;
+  Vec<std::pair<u32, u32>> edges_;
+  Mem<u32> ml_, mr_;
+public:
+  constexpr BipartiteMatching() = default;
+  constexpr BipartiteMatching(u32 left, u32 right) : nl_(left), nr_(right), ml_(left, npos), mr_(right, npos) {}
+  constexpr u32 left_size() const noexcept { return nl_; }
+  constexpr u32 right_size() const noexcept { return nr_; }
+  constexpr void reserve(u32 m) { edges_.reserve(m); }
+  constexpr void add_edge(u32 l, u32 r) {
+#ifndef NDEBUG
+    if(l >= nl_ || r >= nr_) throw Exception("gsh::BipartiteMatching::add_edge / The index is out of range. ( l=", l, ", r=", r, ", left=", nl_, ", right=", nr_, " )");
+#endif
+    edges_.emplace_back(l, r);
+  }
+  // the current matching is kept, so calling it again after adding edges only augments
+  constexpr u32 solve() {
+    Mem<u32> off(nl_ + 1, 0), adj(edges_.size());
+    for(const auto& [l, r] : edges_) ++off[l + 1];
+    for(u32 l = 0; l != nl_; ++l) off[l + 1] += off[l];
+    Mem<u32> pos = off;
+    for(const auto& [l, r] : edges_) adj[pos[l]++] = r;
+    size_ = internal::HopcroftKarp(nl_, off.data(), adj.data(), ml_.data(), mr_.data());
+    return size_;
+  }
+  constexpr u32 size() const noexcept { return size_; }
+  // 0xffffffff if unmatched
+  constexpr u32 match_left(u32 l) const {
+#ifndef NDEBUG
+    if(l >= nl_) throw Exception("gsh::BipartiteMatching::match_left / The index is out of range. ( l=", l, ", left=", nl_, " )");
+#endif
+    return ml_[l];
+  }
+  constexpr u32 match_right(u32 r) const {
+#ifndef NDEBUG
+    if(r >= nr_) throw Exception("gsh::BipartiteMatching::match_right / The index is out of range. ( r=", r, ", right=", nr_, " )");
+#endif
+    return mr_[r];
+  }
+  constexpr Vec<std::pair<u32, u32>> matching() const {
+    Vec<std::pair<u32, u32>> res;
+    res.reserve(size_);
+    for(u32 l = 0; l != nl_; ++l)
+      if(ml_[l] != npos) res.emplace_back(l, ml_[l]);
+    return res;
+  }
+};
+// Hungarian method in O(n^2 m) for a dense cost matrix with n rows and m >= n columns; cost[i][j] must be accessible
+// returns the minimum total cost and the column assigned to each row
+template<class Matrix> constexpr auto MinimumCostAssignment(const Matrix& cost) {
+  using T = std::remove_cvref_t<decltype(cost[0][0])>;
+  const u32 n = std::size(cost);
+  if(n == 0) return std::pair<T, Vec<u32>>{T(0), Vec<u32>()};
+  const u32 m = std::size(cost[0]);
+#ifndef NDEBUG
+  if(n > m) throw Exception("gsh::MinimumCostAssignment / There are more rows than columns. ( n=", n, ", m=", m, " )");
+#endif
+  Mem<T> a(static_cast<u64>(n) * m);
+  for(u32 i = 0; i != n; ++i) {
+    for(u32 j = 0; j != m; ++j) a[static_cast<u64>(i) * m + j] = cost[i][j];
+  }
+  constexpr T inf = std::numeric_limits<T>::max();
+  // 1-indexed potentials; column 0 is a virtual column holding the row being inserted
+  Mem<T> u(n + 1, T(0)), v(m + 1, T(0)), minv(m + 1);
+  Mem<u32> p(m + 1, 0), way(m + 1, 0);
+  Mem<u8> used(m + 1);
+  for(u32 i = 1; i <= n; ++i) {
+    p[0] = i;
+    u32 j0 = 0;
+    for(u32 j = 0; j <= m; ++j) minv[j] = inf, used[j] = 0;
+    do {
+      used[j0] = 1;
+      const u32 i0 = p[j0];
+      const T* row = a.data() + static_cast<u64>(i0 - 1) * m;
+      T delta = inf;
+      u32 j1 = 0;
+      for(u32 j = 1; j <= m; ++j) {
+        if(used[j]) continue;
+        const T cur = row[j - 1] - u[i0] - v[j];
+        if(cur < minv[j]) minv[j] = cur, way[j] = j0;
+        if(minv[j] < delta) delta = minv[j], j1 = j;
+      }
+      for(u32 j = 0; j <= m; ++j) {
+        if(used[j]) u[p[j]] += delta, v[j] -= delta;
+        else minv[j] -= delta;
+      }
+      j0 = j1;
+    } while(p[j0] != 0);
+    do {
+      const u32 j1 = way[j0];
+      p[j0] = p[j1];
+      j0 = j1;
+    } while(j0 != 0);
+  }
+  std::pair<T, Vec<u32>> res{T(0), Vec<u32>(n)};
+  for(u32 j = 1; j <= m; ++j) {
+    if(p[j] == 0) continue;
+    res.second[p[j] - 1] = j - 1;
+    res.first += a[static_cast<u64>(p[j] - 1) * m + (j - 1)];
+  }
+  return res;
+}
+}
@@ -0,0 +1,184 @@
+#pragma once
+#include "Exception.hpp"
+#include "Memory.hpp"
+#include "SegmentTree.hpp"
+#include "TypeDef.hpp"
+#include "Vec.hpp"
+#include <concepts>
+#include <initializer_list>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+namespace gsh {
+// Path-copying segment tree. Every set returns a new version in O(log n) nodes; all versions share one node arena.
+// Versions are plain node indices, so the arena can be rewound (drop everything newer than a checkpoint) or compacted (keep only chosen versions).
+template<class Spec> requires internal::IsSegmentSpecImplemented<Spec> class PersistentSegmentTree {
+  [[no_unique_address]] Spec spec;
+public:
+  using value_type = typename Spec::value_type;
+  using size_type = u32;
+  using difference_type = i32;
+  using version_type = u32;
+private:
+  struct Node {
+    value_type val;
+    u32 left, right;
+  };
+  size_type n = 0;
+  version_type init = 0;
+  Vec<Node> arena;
+  constexpr u32 push(const value_type& val, u32 left, u32 right) {
+    arena.emplace_back(Node{val, left, right});
+    return arena.size() - 1;
+  }
+  template<class F> constexpr u32 build(size_type a, size_type b, F& leaf) {
+    if(b - a == 1) return push(leaf(a), 0, 0);
+    const size_type mid = a + (b - a) / 2;
+    const u32 left = build(a, mid, leaf);
+    const u32 right = build(mid, b, leaf);
+    return push(spec.op(arena[left].val, arena[right].val), left, right);
+  }
+  template<class F> constexpr void build(size_type m, F leaf) {
+    n = m;
+    arena.clear();
+    if(n == 0) {
+      init = push(spec.e(), 0, 0);
+      return;
+    }
+    arena.reserve(2 * n - 1);
+    init = build(0, n, leaf);
+  }
+  constexpr value_type prod(u32 k, size_type a, size_type b, size_type l, size_type r) const {
+    if(l <= a && b <= r) return arena[k].val;
+    const size_type mid = a + (b - a) / 2;
+    if(r <= mid) return prod(arena[k].left, a, mid, l, r);
+    if(mid <= l) return prod(arena[k].right, mid, b, l, r);
+    return spec.op(prod(arena[k].left, a, mid, l, r), prod(arena[k].right, mid, b, l, r));
+  }
+  constexpr u32 copy_reachable(u32 k, size_type a, size_type b, Mem<u32>& remap, Vec<Node>& dst) const {
+    if(remap[k] != 0xffffffff) return remap[k];
+    if(b - a <= 1) {
+      dst.emplace_back(arena[k]);
+    } else {
+      const size_type mid = a + (b - a) / 2;
+      const u32 left = copy_reachable(arena[k].left, a, mid, remap, dst);
+      const u32 right = copy_reachable(arena[k].right, mid, b, remap, dst);
+      dst.emplace_back(Node{arena[k].val, left, right});
+    }
+    return remap[k] = dst.size() - 1;
+  }
+public:
+  constexpr PersistentSegmentTree() : PersistentSegmentTree(0) {}
+  constexpr PersistentSegmentTree(Spec spec) : PersistentSegmentTree(0, spec) {}
+  constexpr PersistentSegmentTree(size_type n, Spec spec = Spec()) : spec(spec) { assign(n, this->spec.e()); }
+  template<class InputIt> requires std::forward_iterator<InputIt> constexpr PersistentSegmentTree(InputIt first, InputIt last, Spec spec = Spec()) : spec(spec) { assign(first, last); }
+  constexpr PersistentSegmentTree(size_type n, const value_type& value, Spec spec = Spec()) : spec(spec) { assign(n, value); }
+  constexpr PersistentSegmentTree(std::initializer_list<value_type> init, Spec spec = Spec()) : PersistentSegmentTree(init.begin(), init.end(), spec) {}
+  template<class InputIt> requires std::forward_iterator<InputIt> constexpr void assign(InputIt first, InputIt last) {
+    const size_type m = std::ranges::distance(first, last);
+    if constexpr(std::random_access_iterator<InputIt>) {
+      build(m, [&](size_type i) -> value_type { return first[i]; });
+    } else {
+      Vec<value_type> tmp(first, last);
+      build(m, [&](size_type i) -> value_type { return tmp[i]; });
+    }
+  }
+  constexpr void assign(size_type n, const value_type& u) {
+    build(n, [&](size_type) -> value_type { return u; });
+  }
+  constexpr void assign(std::initializer_list<value_type> il) { assign(il.begin(), il.end()); }
+  constexpr void swap(PersistentSegmentTree& r) {
+    using std::swap;
+    swap(spec, r.spec);
+    swap(n, r.n);
+    swap(init, r.init);
+    swap(arena, r.arena);
+  }
+  constexpr size_type size() const { return n; }
+  constexpr bool empty() const { return n == 0; }
+  // the version built by the constructor or assign
+  constexpr version_type root() const { return init; }
+  constexpr size_type node_count() const { return arena.size(); }
+  constexpr void reserve(size_type nodes) { arena.reserve(nodes); }
+  constexpr version_type set(version_type v, size_type i, const value_type& x) {
+#ifndef NDEBUG
+    if(v >= arena.size()) throw Exception("PersistentSegmentTree::set: version ", v, " does not exist");
+    if(i >= n) throw Exception("PersistentSegmentTree::set: index ", i, " is out of range [0, ", n, ")");
+#endif
+    u32 path[33];
+    bool go_right[33];
+    u32 depth = 0;
+    size_type a = 0, b = n;
+    u32 k = v;
+    while(b - a > 1) {
+      const size_type mid = a + (b - a) / 2;
+      path[depth] = k;
+      go_right[depth] = i >= mid;
+      ++depth;
+      if(i < mid) k = arena[k].left, b = mid;
+      else k = arena[k].right, a = mid;
+    }
+    u32 cur = push(x, 0, 0);
+    while(depth--) {
+      const Node& old = arena[path[depth]];
+      const u32 left = go_right[depth] ? old.left : cur;
+      const u32 right = go_right[depth] ? cur : old.right;
+      cur = push(spec.op(arena[left].val, arena[right].val), left, right);
+    }
+    return cur;
+  }
+  constexpr value_type get(version_type v, size_type i) const {
+#ifndef NDEBUG
+    if(v >= arena.size()) throw Exception("PersistentSegmentTree::get: version ", v, " does not exist");
+    if(i >= n) throw Exception("PersistentSegmentTree::get: index ", i, " is out of range [0, ", n, ")");
+#endif
+    size_type a = 0, b = n;
+    u32 k = v;
+    while(b - a > 1) {
+      const size_type mid = a + (b - a) / 2;
+      if(i < mid) k = arena[k].left, b = mid;
+      else k = arena[k].right, a = mid;
+    }
+    return arena[k].val;
+  }
+  constexpr value_type prod(version_type v, size_type l, size_type r) const {
+#ifndef NDEBUG
+    if(v >= arena.size()) throw Exception("PersistentSegmentTree::prod: version ", v, " does not exist");
+    if(l > r || r > n) throw Exception("PersistentSegmentTree::prod: invalid range [", l, ", ", r, ") with size ", n);
+#endif
+    if(l == r) return spec.e();
+    return prod(v, 0, n, l, r);
+  }
+  constexpr value_type all_prod(version_type v) const {
+#ifndef NDEBUG
+    if(v >= arena.size()) throw Exception("PersistentSegmentTree::all_prod: version ", v, " does not exist");
+#endif
+    return arena[v].val;
+  }
+  // Every version created after checkpoint() can be discarded at once by rewind().
+  constexpr size_type checkpoint() const { return arena.size(); }
+  constexpr void rewind(size_type mark) {
+#ifndef NDEBUG
+    if(mark < init + 1 || mark > arena.size()) throw Exception("PersistentSegmentTree::rewind: invalid checkpoint ", mark, " (node count ", arena.size(), ")");
+#endif
+    arena.resize(mark);
+  }
+  // Drops every version except root().
+  constexpr void reset() { arena.resize(init + 1); }
+  // Keeps root() and the versions in [first, last), which are rewritten to their new ids; every other version is freed.
+  template<class ForwardIt> requires std::forward_iterator<ForwardIt> && std::same_as<std::iter_value_t<ForwardIt>, version_type> constexpr void compact(ForwardIt first, ForwardIt last) {
+    Mem<u32> remap(arena.size(), 0xffffffff);
+    Vec<Node> dst;
+    dst.reserve(2 * n);
+    const size_type b = n > 0 ? n : 1;
+    init = copy_reachable(init, 0, b, remap, dst);
+    for(auto it = first; it != last; ++it) {
+#ifndef NDEBUG
+      if(*it >= arena.size()) throw Exception("PersistentSegmentTree::compact: version ", *it, " does not exist");
+#endif
+      *it = copy_reachable(*it, 0, b, remap, dst);
+    }
+    arena = std::move(dst);
+  }
+};
+}
@@ -2,6 +2,7 @@
 #include "Memory.hpp"
 #include "TypeDef.hpp"
 #include "Vec.hpp"
+#include "internal/Parallel.hpp"
 #include <algorithm>
 #include <functional>
 #include <ranges>
@@ -37,81 +38,119 @@ public:
 };
 }
 template<class E, class V = E, class Merge, class Identity, class PutEdge = internal::ReRootingNoOpPutEdge<V, E>, class PutVertex = internal::ReRootingNoOpPutVertex<E, V>> constexpr internal::DefaultReRootingSpec<E, V, Merge, Identity, PutEdge, PutVertex> MakeReRootingSpec(const Merge& merge = Merge(), const Identity& id = Identity(), const PutEdge& put_edge = PutEdge(), const PutVertex& put_vertex = PutVertex()) { return {merge, id, put_edge, put_vertex}; }
-template<class Spec, std::ranges::forward_range EdgeRange> requires std::ranges::sized_range<EdgeRange> constexpr Vec<typename Spec::value_type> ReRooting(const EdgeRange& edges, Spec spec = Spec()) {
-  using E = typename Spec::edge_type;
-  using V = typename Spec::value_type;
-  const u32 m = static_cast<u32>(std::ranges::size(edges));
-  u32 n = m + 1;
-  Mem<u32> deg(n, 0);
-  for(auto&& [a, b] : edges) {
-    ++deg[static_cast<u32>(a)];
-    ++deg[static_cast<u32>(b)];
-  }
-  Mem<u32> off(n + 1);
-  u32 max_deg = deg[0];
-  off[0] = max_deg;
-  for(u32 v = 1; v != n; ++v) {
-    u32 d = deg[v];
-    max_deg = std::max(max_deg, d);
-    off[v] = off[v - 1] + d;
-  }
-  off[n] = off[n - 1];
+template<class E, class V> class ReRootingBuffer;
+// adjacency and dfs order of a tree rooted at 0; build it once and run ReRooting with as many specs as needed
+class ReRootingTree {
+  template<class Spec, class E, class V> friend constexpr void ReRooting(const ReRootingTree&, Vec<V>&, ReRootingBuffer<E, V>&, Spec, u32);
   struct Adj {
     u32 to;
     u32 edge_idx;
     u32 rev_idx;
   };
-  Mem<Adj> g(2 * m);
-  for(u32 i = 0; auto&& [a, b] : edges) {
-    const u32 x = static_cast<u32>(a);
-    const u32 y = static_cast<u32>(b);
-    const u32 ix = --off[x];
-    const u32 iy = --off[y];
-    std::construct_at(&g[ix], y, i, iy);
-    std::construct_at(&g[iy], x, i + m, ix);
-    ++i;
-  }
-  constexpr u32 npos = 0xffffffffu;
-  Mem<u32> parent(n, npos);
-  Mem<u32> parent_dir(n, npos);
-  Mem<u32> order(n);
-  u32 order_sz = 0;
-  {
+  static constexpr u32 npos = 0xffffffffu;
+  u32 n_ = 0, m_ = 0, max_deg_ = 0;
+  Mem<u32> off_;
+  Mem<Adj> g_;
+  Mem<u32> order_;
+  Mem<u32> parent_dir_; // the arc from v to its parent
+  Mem<u32> size_;       // subtree sizes
+public:
+  constexpr ReRootingTree() = default;
+  template<std::ranges::forward_range EdgeRange> requires std::ranges::sized_range<EdgeRange> constexpr explicit ReRootingTree(const EdgeRange& edges) { assign(edges); }
+  template<std::ranges::forward_range EdgeRange> requires std::ranges::sized_range<EdgeRange> constexpr void assign(const EdgeRange& edges) {
+    const u32 m = static_cast<u32>(std::ranges::size(edges));
+    const u32 n = m + 1;
+    n_ = n, m_ = m;
+    Mem<u32> deg(n, 0);
+    for(auto&& [a, b] : edges) {
+      ++deg[static_cast<u32>(a)];
+      ++deg[static_cast<u32>(b)];
+    }
+    off_ = Mem<u32>(n + 1);
+    u32 max_deg = deg[0];
+    off_[0] = max_deg;
+    for(u32 v = 1; v != n; ++v) {
+      u32 d = deg[v];
+      max_deg = std::max(max_deg, d);
+      off_[v] = off_[v - 1] + d;
+    }
+    off_[n] = off_[n - 1];
+    max_deg_ = max_deg;
+    g_ = Mem<Adj>(2 * m);
+    for(u32 i = 0; auto&& [a, b] : edges) {
+      const u32 x = static_cast<u32>(a);
+      const u32 y = static_cast<u32>(b);
+      const u32 ix = --off_[x];
+      const u32 iy = --off_[y];
+      std::construct_at(&g_[ix], y, i, iy);
+      std::construct_at(&g_[iy], x, i + m, ix);
+      ++i;
+    }
+    Mem<u32> parent(n, npos);
+    parent_dir_ = Mem<u32>(n, npos);
+    order_ = Mem<u32>(n);
+    u32 order_sz = 0;
     Mem<u32> st(n);
     u32 sp = 0;
     parent[0] = 0;
     st[sp++] = 0;
     while(sp) {
       const u32 v = st[--sp];
-      order[order_sz++] = v;
-      for(u32 ei = off[v]; ei != off[v + 1]; ++ei) {
-        const u32 to = g[ei].to;
+      order_[order_sz++] = v;
+      for(u32 ei = off_[v]; ei != off_[v + 1]; ++ei) {
+        const u32 to = g_[ei].to;
         if(to == parent[v] || parent[to] != npos) continue;
         parent[to] = v;
-        parent_dir[to] = g[ei].rev_idx;
+        parent_dir_[to] = g_[ei].rev_idx;
         st[sp++] = to;
       }
     }
+    size_ = Mem<u32>(n, 1);
+    for(u32 it = n; --it;) size_[parent[order_[it]]] += size_[order_[it]];
   }
+  constexpr u32 vertex_count() const noexcept { return n_; }
+  constexpr u32 edge_count() const noexcept { return m_; }
+};
+// scratch space for ReRooting; it only grows, so reusing it across runs on the same tree allocates nothing
+template<class E, class V> class ReRootingBuffer {
+  template<class Spec, class E2, class V2> friend constexpr void ReRooting(const ReRootingTree&, Vec<V2>&, ReRootingBuffer<E2, V2>&, Spec, u32);
+  Mem<V> msg;
+  Mem<E> suffix, contrib;
+public:
+  constexpr ReRootingBuffer() = default;
+};
+// With threads > 1 the subtrees below the vertices holding more than n / (4 * threads) vertices are processed concurrently, so spec is called from several threads at once.
+template<class Spec, class E, class V> constexpr void ReRooting(const ReRootingTree& tree, Vec<V>& res, ReRootingBuffer<E, V>& buf, Spec spec, u32 threads) {
+  static_assert(std::is_same_v<E, typename Spec::edge_type> && std::is_same_v<V, typename Spec::value_type>, "gsh::ReRooting / The buffer does not match the types of the spec.");
+  const u32 n = tree.n_, m = tree.m_;
+  const auto& off = tree.off_;
+  const auto& g = tree.g_;
+  const auto& order = tree.order_;
+  const auto& parent_dir = tree.parent_dir_;
+  const u32 max_deg = tree.max_deg_;
+  if(std::is_constant_evaluated()) threads = 1;
+  else threads = internal::ThreadsFor(n, threads, 1 << 14);
+  const u32 limit = std::max(n / (4 * threads), 1u);
+  // scratch of thread th starts at slot(th); vertices off the top part have degree at most limit + 1
+  auto slot = [&](u32 th) { return th == 0 ? 0 : max_deg + (th - 1) * (limit + 1); };
   const V init_v = spec.put_vertex(spec.identity(), 0);
-  Mem<V> msg(2 * m, init_v);
-  for(u32 it = order_sz; it--;) {
-    const u32 v = order[it];
+  if(buf.msg.size() < 2 * m) buf.msg = Mem<V>(2 * m, init_v);
+  if(buf.suffix.size() < slot(threads)) buf.suffix = Mem<E>(slot(threads), spec.identity()), buf.contrib = Mem<E>(slot(threads), spec.identity());
+  auto& msg = buf.msg;
+  res.assign(n, init_v);
+  auto up = [&](u32 v) {
     E lower = spec.identity();
     for(u32 ei = off[v]; ei != off[v + 1]; ++ei) {
-      const u32 to = g[ei].to;
-      if(v != 0 && to == parent[v]) continue;
+      if(ei == parent_dir[v]) continue;
       u32 idx = g[ei].edge_idx;
       lower = spec.merge(lower, spec.put_edge(msg[g[ei].rev_idx], idx >= m ? idx - m : idx, idx >= m));
     }
     V branch = spec.put_vertex(lower, v);
     if(v != 0) msg[parent_dir[v]] = std::move(branch);
-  }
-  Mem<E> suffix_buf(max_deg, spec.identity());
-  Mem<E> contrib_buf(max_deg, spec.identity());
-  Vec<V> res(n, init_v);
-  for(u32 it = 0; it != order_sz; ++it) {
-    const u32 v = order[it];
+  };
+  auto down = [&](u32 v, u32 th) {
+    E* suffix_buf = buf.suffix.data() + slot(th);
+    E* contrib_buf = buf.contrib.data() + slot(th);
     const u32 dv = off[v + 1] - off[v];
     E suffix = spec.identity();
     for(u32 k = dv; k--;) {
@@ -129,7 +168,54 @@ template<class Spec, std::ranges::forward_range EdgeRange> requires std::ranges:
       prefix = spec.merge(prefix, contrib_buf[k]);
     }
     res[v] = spec.put_vertex(prefix, v);
+  };
+  if(threads == 1) {
+    for(u32 it = n; it--;) up(order[it]);
+    for(u32 it = 0; it != n; ++it) down(order[it], 0);
+    return;
   }
+  // order is a preorder, so every subtree is a contiguous range of it; big subtrees form a connected top part
+  Vec<u32> top, task;
+  for(u32 it = 0; it != n;) {
+    const u32 sz = tree.size_[order[it]];
+    if(sz > limit) top.push_back(it++);
+    else task.push_back(it), it += sz;
+  }
+  task.push_back(n);
+  // thread th takes the tasks starting in the th-th slice of the non-top vertices
+  const u32 rest = n - top.size();
+  auto run_tasks = [&](auto&& f) {
+    internal::ParallelFor(threads, [&](u32 th) {
+      const u64 lo = static_cast<u64>(rest) * th / threads, hi = static_cast<u64>(rest) * (th + 1) / threads;
+      u64 done = 0;
+      for(u32 k = 0; k + 1 < task.size(); ++k) {
+        const u32 a = task[k], b = a + tree.size_[order[a]];
+        if(lo <= done && done < hi) f(a, b, th);
+        done += b - a;
+      }
+    });
+  };
+  run_tasks([&](u32 a, u32 b, u32) {
+    for(u32 it = b; it-- != a;) up(order[it]);
+  });
+  for(u32 k = top.size(); k--;) up(order[top[k]]);
+  for(u32 k = 0; k != top.size(); ++k) down(order[top[k]], 0);
+  run_tasks([&](u32 a, u32 b, u32 th) {
+    for(u32 it = a; it != b; ++it) down(order[it], th);
+  });
+}
+template<class Spec, class E, class V> constexpr void ReRooting(const ReRootingTree& tree, Vec<V>& res, ReRootingBuffer<E, V>& buf, Spec spec) { ReRooting(tree, res, buf, spec, 1); }
+template<class Spec> constexpr Vec<typename Spec::value_type> ReRooting(const ReRootingTree& tree, Spec spec = Spec()) {
+  Vec<typename Spec::value_type> res;
+  ReRootingBuffer<typename Spec::edge_type, typename Spec::value_type> buf;
+  ReRooting(tree, res, buf, spec);
+  return res;
+}
+template<class Spec> Vec<typename Spec::value_type> ReRooting(const ReRootingTree& tree, Spec spec, u32 threads) {
+  Vec<typename Spec::value_type> res;
+  ReRootingBuffer<typename Spec::edge_type, typename Spec::value_type> buf;
+  ReRooting(tree, res, buf, spec, threads);
   return res;
 }
+template<class Spec, std::ranges::forward_range EdgeRange> requires std::ranges::sized_range<EdgeRange> constexpr Vec<typename Spec::value_type> ReRooting(const EdgeRange& edges, Spec spec = Spec()) { return ReRooting(ReRootingTree(edges), spec); }
 }
@@ -5,6 +5,7 @@
 #include "Numeric.hpp"
 #include "Range.hpp"
 #include "TypeDef.hpp"
+#include "Util.hpp"
 #include "Vec.hpp"
 #include <bit>
 #include <concepts>
@@ -91,6 +92,7 @@ public:
   }
   constexpr bool empty() const { return n == 0; }
   constexpr size_type size() const { return n; }
+  constexpr const Spec& get_spec() const noexcept { return spec; }
   constexpr void resize(size_type n) { resize(n, spec.e()); }
   constexpr void resize(size_type n, const value_type& c) {
     Vec<value_type> tmp;
@@ -216,4 +218,217 @@ public:
     return 0;
   }
 };
+namespace internal {
+template<class T> struct alignas(64) WideSegmentBlock {
+  static constexpr u32 width = 64 / sizeof(T);
+  T v[width];
+};
+// reduces p[a, b) in lane order; the fixed trip count lets the compiler vectorize the blend and the reduction
+template<u32 B, class Spec, class T> GSH_INTERNAL_INLINE constexpr T WideSegmentReduce(const Spec& spec, const T* p, u32 a, u32 b) {
+  const T e = spec.e();
+  T x[B];
+  for(u32 j = 0; j != B; ++j) {
+    const T v = p[j];
+    x[j] = j - a < b - a ? v : e;
+  }
+  T res = e;
+  for(u32 j = 0; j != B; ++j) res = spec.op(res, x[j]);
+  return res;
+}
+// reduces p[0, B) as if p[k] were y, without reading back a lane that was just stored
+template<u32 B, class Spec, class T> GSH_INTERNAL_INLINE constexpr T WideSegmentReduceWith(const Spec& spec, const T* p, u32 k, const T& y) {
+  T x[B];
+  for(u32 j = 0; j != B; ++j) {
+    const T v = p[j];
+    x[j] = j == k ? y : v;
+  }
+  T res = spec.e();
+  for(u32 j = 0; j != B; ++j) res = spec.op(res, x[j]);
+  return res;
+}
+}
+// B-ary segment tree (B = 64 / sizeof(value_type)) for arithmetic value types.
+// every node is one cache line, so prod and the ascent of max_right / min_left reduce a whole node per level.
+template<class Spec> requires internal::IsSegmentSpecImplemented<Spec> && std::is_arithmetic_v<typename Spec::value_type> class WideSegmentTree {
+  [[no_unique_address]] Spec spec;
+public:
+  using value_type = typename Spec::value_type;
+  using size_type = u32;
+  using difference_type = i32;
+private:
+  using block_type = internal::WideSegmentBlock<value_type>;
+  constexpr static size_type B = block_type::width;
+  size_type n = 0;
+  size_type height = 0;
+  size_type len[16] = {};  // number of elements on each level
+  size_type off[16] = {};  // first block of each level
+  Vec<block_type> tree;
+  constexpr value_type* node(size_type h, size_type i) { return tree[off[h] + i].v; }
+  constexpr const value_type* node(size_type h, size_type i) const { return tree[off[h] + i].v; }
+  constexpr void allocate(size_type m) {
+    n = m;
+    height = 0;
+    if(m == 0) {
+      tree.clear();
+      return;
+    }
+    size_type total = 0;
+    for(size_type k = m;; k = (k + B - 1) / B) {
+      len[height] = k;
+      off[height] = total;
+      total += (k + B - 1) / B;
+      ++height;
+      if(k <= B) break;
+    }
+    block_type blk;
+    for(size_type j = 0; j != B; ++j) blk.v[j] = spec.e();
+    tree.assign(total, blk);
+  }
+  constexpr void build() {
+    for(size_type h = 1; h < height; ++h)
+      for(size_type i = 0; i != len[h]; ++i) node(h, i / B)[i % B] = internal::WideSegmentReduce<B>(spec, node(h - 1, i), 0, B);
+  }
+public:
+  constexpr WideSegmentTree() {}
+  constexpr WideSegmentTree(Spec spec) : spec(spec) {}
+  constexpr WideSegmentTree(size_type n, Spec spec = Spec()) : spec(spec) { allocate(n); }
+  template<class InputIt> requires std::forward_iterator<InputIt> constexpr WideSegmentTree(InputIt first, InputIt last, Spec spec = Spec()) : spec(spec) { assign(first, last); }
+  constexpr WideSegmentTree(size_type n, const value_type& value, Spec spec = Spec()) : spec(spec) { assign(n, value); }
+  constexpr WideSegmentTree(std::initializer_list<value_type> init, Spec spec = Spec()) : WideSegmentTree(init.begin(), init.end(), spec) {}
+  constexpr WideSegmentTree& operator=(std::initializer_list<value_type> il) {
+    assign(il);
+    return *this;
+  }
+  constexpr void clear() { allocate(0); }
+  constexpr bool empty() const { return n == 0; }
+  constexpr size_type size() const { return n; }
+  constexpr const Spec& get_spec() const noexcept { return spec; }
+  template<class InputIt> requires std::forward_iterator<InputIt> constexpr void assign(InputIt first, InputIt last) {
+    allocate(std::ranges::distance(first, last));
+    auto it = first;
+    for(size_type i = 0; i < n; ++i, ++it) node(0, i / B)[i % B] = *it;
+    build();
+  }
+  constexpr void assign(size_type n, const value_type& u) {
+    allocate(n);
+    for(size_type i = 0; i < n; ++i) node(0, i / B)[i % B] = u;
+    build();
+  }
+  constexpr void assign(std::initializer_list<value_type> il) { assign(il.begin(), il.end()); }
+  constexpr void swap(WideSegmentTree& r) {
+    using std::swap;
+    swap(spec, r.spec);
+    swap(n, r.n);
+    swap(height, r.height);
+    swap(len, r.len);
+    swap(off, r.off);
+    swap(tree, r.tree);
+  }
+  constexpr value_type prod(size_type l, size_type r) const {
+#ifndef NDEBUG
+    if(l > r || r > n) throw Exception("WideSegmentTree::prod: invalid range [", l, ", ", r, ") with size ", n);
+#endif
+    // the visited nodes depend only on l and r, so every level can be fetched up front
+    for(size_type h = 0, pl = l, pr = r; pl < pr; ++h) {
+      Prefetch(node(h, pl / B));
+      Prefetch(node(h, (pr - 1) / B));
+      pl = pl / B + 1;
+      pr = pr / B;
+    }
+    value_type sml = spec.e(), smr = spec.e();
+    for(size_type h = 0; l < r; ++h) {
+      const size_type bl = l / B, br = r / B;
+      if(bl == br) {
+        sml = spec.op(sml, internal::WideSegmentReduce<B>(spec, node(h, bl), l % B, r % B));
+        break;
+      }
+      sml = spec.op(sml, internal::WideSegmentReduce<B>(spec, node(h, bl), l % B, B));
+      if(r % B != 0) smr = spec.op(internal::WideSegmentReduce<B>(spec, node(h, br), 0, r % B), smr);
+      l = bl + 1;
+      r = br;
+    }
+    return spec.op(sml, smr);
+  }
+  constexpr value_type all_prod() const { return n > 0 ? internal::WideSegmentReduce<B>(spec, node(height - 1, 0), 0, B) : spec.e(); }
+  constexpr void set(size_type i, const value_type& x) {
+#ifndef NDEBUG
+    if(i >= n) throw Exception("WideSegmentTree::set: index ", i, " is out of range [0, ", n, ")");
+#endif
+    for(size_type h = 0, j = i; h != height; ++h, j /= B) Prefetch(node(h, j / B));
+    value_type y = x;
+    for(size_type h = 0; h + 1 < height; ++h) {
+      value_type* p = node(h, i / B);
+      const value_type z = internal::WideSegmentReduceWith<B>(spec, p, i % B, y);
+      p[i % B] = y;
+      y = z;
+      i /= B;
+    }
+    node(height - 1, 0)[i] = y;
+  }
+  constexpr const value_type& operator[](size_type i) const {
+#ifndef NDEBUG
+    if(i >= n) throw Exception("WideSegmentTree::operator[]: index ", i, " is out of range [0, ", n, ")");
+#endif
+    return node(0, i / B)[i % B];
+  }
+  constexpr const value_type& get(size_type i) const { return (*this)[i]; }
+  // Returns the maximum r (l <= r <= n) such that f(prod(l, r)) is true.
+  // Constraint: f(spec.e()) must be true.
+  template<class F> constexpr size_type max_right(size_type l, F f) const {
+#ifndef NDEBUG
+    if(l > n) throw Exception("WideSegmentTree::max_right: index ", l, " is out of range [0, ", n, "]");
+    if(!std::invoke(f, spec.e())) throw Exception("WideSegmentTree::max_right: predicate must be true for identity");
+#endif
+    if(l == n) return n;
+    value_type sm = spec.e();
+    size_type h = 0;
+    while(true) {
+      const value_type t = spec.op(sm, internal::WideSegmentReduce<B>(spec, node(h, l / B), l % B, B));
+      if(!std::invoke(f, t)) break;
+      sm = t;
+      l = l / B + 1;
+      if(++h == height || l >= len[h]) return n;
+    }
+    while(true) {
+      const value_type* p = node(h, l / B);
+      while(true) {
+        const value_type t = spec.op(sm, p[l % B]);
+        if(!std::invoke(f, t)) break;
+        sm = t;
+        ++l;
+      }
+      if(h-- == 0) return l;
+      l *= B;
+    }
+  }
+  // Returns the minimum l (0 <= l <= r) such that f(prod(l, r)) is true.
+  // Constraint: f(spec.e()) must be true.
+  template<class F> constexpr size_type min_left(size_type r, F f) const {
+#ifndef NDEBUG
+    if(r > n) throw Exception("WideSegmentTree::min_left: index ", r, " is out of range [0, ", n, "]");
+    if(!std::invoke(f, spec.e())) throw Exception("WideSegmentTree::min_left: predicate must be true for identity");
+#endif
+    if(r == 0) return 0;
+    value_type sm = spec.e();
+    size_type h = 0;
+    while(true) {
+      const value_type t = spec.op(internal::WideSegmentReduce<B>(spec, node(h, (r - 1) / B), 0, (r - 1) % B + 1), sm);
+      if(!std::invoke(f, t)) break;
+      sm = t;
+      r = (r - 1) / B;
+      if(++h == height || r == 0) return 0;
+    }
+    while(true) {
+      const value_type* p = node(h, (r - 1) / B);
+      while(true) {
+        const value_type t = spec.op(p[(r - 1) % B], sm);
+        if(!std::invoke(f, t)) break;
+        sm = t;
+        --r;
+      }
+      if(h-- == 0) return r;
+      r *= B;
+    }
+  }
+};
 }
@@ -5,6 +5,7 @@
 #include "Numeric.hpp"
 #include "Range.hpp"
 #include "TypeDef.hpp"
+#include "Util.hpp"
 #include "Vec.hpp"
 #include <bit>
 #include <concepts>
@@ -188,6 +189,23 @@ public:
     res = spec.op(res, suf[r - 1]);
     return res;
   }
+  // touches the cache lines prod(l, r) will read, so that independent queries can overlap their misses
+  constexpr void prefetch(size_type l, size_type r) const {
+    if(l == r) return;
+    const size_type L = l >> block_shift;
+    const size_type R = (r - 1) >> block_shift;
+    if(L == R) {
+      Prefetch(data.data() + l);
+      return;
+    }
+    Prefetch(pre.data() + l);
+    Prefetch(suf.data() + (r - 1));
+    if(L + 1 < R) {
+      const size_type k = std::bit_width(R - L - 1) - 1;
+      Prefetch(table.data() + offset[k] + L + 1);
+      Prefetch(table.data() + offset[k] + R - (1u << k));
+    }
+  }
   constexpr value_type all_prod() const { return n > 0 ? prod(0, n) : spec.e(); }
   constexpr const value_type& operator[](size_type i) const {
 #ifndef NDEBUG
@@ -52,6 +52,13 @@ GSH_INTERNAL_INLINE constexpr bool Unpredictable(const bool f) {
   return f;
 #endif
 }
+// hint that *p will be read soon
+GSH_INTERNAL_INLINE constexpr void Prefetch([[maybe_unused]] const void* p) noexcept {
+  if(std::is_constant_evaluated()) return;
+#if defined __GNUC__ || defined __clang__
+  __builtin_prefetch(p);
+#endif
+}
 GSH_INTERNAL_INLINE inline void PreventConstexpr() noexcept {
   [[maybe_unused]] thread_local u8 dummy = 0;
   ++dummy;
@@ -0,0 +1,44 @@
+#pragma once
+#include "../TypeDef.hpp"
+#include "../Vec.hpp"
+#include <algorithm>
+#include <thread>
+#include <type_traits>
+namespace gsh { namespace internal {
+// one thread in constant evaluation, so constexpr functions can take it as a default argument
+constexpr u32 DefaultThreads() {
+  if(std::is_constant_evaluated()) return 1;
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+// number of threads worth starting for n items when each thread should get at least grain of them
+inline u32 ThreadsFor(u64 n, u32 threads, u64 grain) { return static_cast<u32>(std::clamp<u64>(n / std::max<u64>(grain, 1), 1, std::max(threads, 1u))); }
+// calls f(0), ..., f(threads - 1), each on its own thread; f(0) runs on the caller
+template<class F> void ParallelFor(u32 threads, F&& f) {
+  Vec<std::jthread> th;
+  if(threads > 1) th.reserve(threads - 1);
+  for(u32 t = 1; t < threads; ++t) th.emplace_back([&f, t]() { f(t); });
+  f(0);
+}
+// splits [0, n) into threads contiguous chunks and runs f(t, first, last) on each
+template<class F> void ParallelChunks(u32 threads, u64 n, F&& f) {
+  threads = std::max(threads, 1u);
+  ParallelFor(threads, [&](u32 t) { f(t, n * t / threads, n * (t + 1) / threads); });
+}
+// like ParallelChunks, but the boundaries split the non-decreasing weights pre(0) = 0, ..., pre(n) evenly instead of the indices
+template<class P, class F> void ParallelBalancedChunks(u32 threads, u64 n, P&& pre, F&& f) {
+  threads = std::max(threads, 1u);
+  const u64 total = pre(n);
+  auto bound = [&](u32 t) {
+    if(t == threads) return n;
+    const u64 target = total * t / threads;
+    u64 lo = 0, hi = n;
+    while(lo < hi) {
+      const u64 mid = lo + (hi - lo) / 2;
+      if(pre(mid) < target) lo = mid + 1;
+      else hi = mid;
+    }
+    return lo;
+  };
+  ParallelFor(threads, [&](u32 t) { f(t, bound(t), bound(t + 1)); });
+}
+} }